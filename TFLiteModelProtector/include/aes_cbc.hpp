@@ -0,0 +1,138 @@
+#ifndef TFLITE_AES_CBC_H_
+#define TFLITE_AES_CBC_H_
+
+#include <openssl/evp.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "cpu_features.hpp"
+
+// Bulk CBC decryption kernel for one path, called without dispatch. Defined for the x86 paths,
+// on x86 only; `iv` carries the chaining value in and out.
+template <AesPath Path>
+void CbcDecryptKernel(const uint8_t* schedule, const uint8_t* in, uint8_t* out, size_t blocks,
+					  uint8_t* iv);
+
+/**
+ * @brief AES-256-CBC bulk decryptor that dispatches to the kernel chosen by CpuFeatures.
+ *
+ * CBC decryption has no dependency between blocks, so the AES-NI and VAES kernels keep 8 to 16
+ * blocks in flight. Only whole blocks are handled here; padding removal of the final block is
+ * left to the caller (see TFLiteModelProtector::DecryptToBuffer). The chaining value carries
+ * over between calls, and `in == out` is allowed.
+ */
+class AesCbcDecryptor {
+   public:
+	static constexpr size_t kBlockSize = 16;
+	static constexpr int kRounds = 14;
+
+	AesCbcDecryptor(const uint8_t* key, const uint8_t* iv);
+	AesCbcDecryptor(const uint8_t* key, const uint8_t* iv, AesPath path);
+	~AesCbcDecryptor();
+
+	AesCbcDecryptor(const AesCbcDecryptor&) = delete;
+	AesCbcDecryptor& operator=(const AesCbcDecryptor&) = delete;
+
+	bool DecryptBlocks(const uint8_t* in, uint8_t* out, size_t blocks);
+	void SetChainingValue(const uint8_t* iv);
+
+	// DecryptBlocks() with the path fixed at compile time. path() must be `Path`.
+	template <AesPath Path>
+	bool DecryptBlocksWith(const uint8_t* in, uint8_t* out, size_t blocks) {
+		if constexpr (Path == AesPath::kPortable) {
+			return DecryptBlocksPortable(in, out, blocks);
+		} else {
+			CbcDecryptKernel<Path>(round_keys_, in, out, blocks, iv_);
+			return true;
+		}
+	}
+
+	const uint8_t* chaining_value() const { return iv_; }
+	AesPath path() const { return path_; }
+
+   private:
+	bool DecryptBlocksPortable(const uint8_t* in, uint8_t* out, size_t blocks);
+
+	AesPath path_;
+	alignas(16) uint8_t round_keys_[(kRounds + 1) * kBlockSize];  // Decryption schedule
+	alignas(16) uint8_t iv_[kBlockSize];
+	EVP_CIPHER_CTX* ctx_ = nullptr;	 // Only used by AesPath::kPortable
+};
+
+/**
+ * @brief Derives the IV of each chunk of a chunked file: AES-256-ECB(key, iv ^ tweak ^ index).
+ *
+ * Encrypting the counter keeps chunk IVs unpredictable, as CBC requires, while letting any
+ * chunk be decrypted on its own. The ECB context is kept, so a derivation costs one block.
+ */
+class ChunkIvDeriver {
+   public:
+	ChunkIvDeriver(const uint8_t* key, const uint8_t* iv);
+	~ChunkIvDeriver();
+
+	ChunkIvDeriver(const ChunkIvDeriver&) = delete;
+	ChunkIvDeriver& operator=(const ChunkIvDeriver&) = delete;
+
+	bool Derive(uint64_t index, uint8_t* chunk_iv);
+
+   private:
+	uint8_t base_[AesCbcDecryptor::kBlockSize];
+	EVP_CIPHER_CTX* ctx_ = nullptr;
+};
+
+/**
+ * @brief Decrypts a file body that is either one CBC stream (`chunk_size` 0) or a sequence of
+ * independently chained chunks of `chunk_size` bytes.
+ *
+ * DecryptBlocks() splits calls at chunk boundaries and starts each chunk from its derived IV, so
+ * callers walk both layouts the same way. chaining_value() is always the value the next block
+ * needs, which makes the final padded block work unchanged with DecryptFinalBlock().
+ */
+class ChunkedCbcDecryptor {
+   public:
+	ChunkedCbcDecryptor(const uint8_t* key, const uint8_t* iv, size_t chunk_size);
+
+	bool DecryptBlocks(const uint8_t* in, uint8_t* out, size_t blocks);
+	bool SeekToChunk(uint64_t index);
+
+	const uint8_t* chaining_value() const { return decryptor_.chaining_value(); }
+
+   private:
+	bool StartChunk(uint64_t index);
+
+	AesCbcDecryptor decryptor_;
+	ChunkIvDeriver ivs_;
+	const size_t chunk_blocks_;	 // 0 for a single stream
+	size_t block_in_chunk_ = 0;
+	uint64_t chunk_index_ = 0;
+	bool ok_ = true;
+};
+
+/**
+ * @brief Encryption counterpart of ChunkedCbcDecryptor, with PKCS#7 padding at the very end.
+ *
+ * Full chunks carry no padding, so a chunked body is exactly as long as a single-stream one.
+ */
+class ChunkedCbcEncryptor {
+   public:
+	ChunkedCbcEncryptor(const uint8_t* key, const uint8_t* iv, size_t chunk_size);
+	~ChunkedCbcEncryptor();
+
+	ChunkedCbcEncryptor(const ChunkedCbcEncryptor&) = delete;
+	ChunkedCbcEncryptor& operator=(const ChunkedCbcEncryptor&) = delete;
+
+	// `out` must have room for `length` plus one block.
+	bool Update(const uint8_t* in, size_t length, uint8_t* out, size_t* out_length);
+	bool Final(uint8_t* out, size_t* out_length);
+
+   private:
+	ChunkIvDeriver ivs_;
+	EVP_CIPHER_CTX* ctx_ = nullptr;
+	const size_t chunk_size_;  // 0 for a single stream
+	size_t offset_in_chunk_ = 0;
+	uint64_t chunk_index_ = 0;
+	bool ok_ = true;
+};
+
+#endif	// TFLITE_AES_CBC_H_
@@ -0,0 +1,363 @@
+#ifndef TFLITE_BASIC_MODEL_PROTECTOR_H_
+#define TFLITE_BASIC_MODEL_PROTECTOR_H_
+
+#include <openssl/crypto.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "aes_cbc.hpp"
+#include "content_hash.hpp"
+#include "embedded_model.hpp"
+#include "model_format.hpp"
+#include "protector_metrics.hpp"
+#include "sequential_file.hpp"
+
+/**
+ * @brief Cipher policy: AES-256-CBC with the kernel for `Path`, as one stream or chunked.
+ */
+template <AesPath Path, bool Chunked = false>
+struct AesCbcPolicy {
+	static constexpr AesPath kPath = Path;
+	static constexpr size_t kChunkSize = Chunked ? ModelHeader::kChunkSize : 0;	 // 0: one stream
+	static constexpr uint8_t kCipher =
+		Chunked ? ModelHeader::kCipherAes256CbcChunked : ModelHeader::kCipherAes256Cbc;
+};
+
+/**
+ * @brief I/O policy: reads the ciphertext from a file, `IoChunkSize` bytes per step.
+ *
+ * With `DropPageCache`, ciphertext pages are dropped from the page cache once decrypted.
+ */
+template <size_t IoChunkSize = 256 * 1024, bool DropPageCache = true>
+struct FileIo {
+	using Source = std::string;
+	static constexpr size_t kIoChunkSize = IoChunkSize;
+	static constexpr bool kDropPageCache = DropPageCache;
+
+	class Reader {
+	   public:
+		bool Open(const Source& path) { return file_.Open(path); }
+		size_t size() const { return file_.size(); }
+		bool Read(void* out, size_t length) { return file_.Read(out, length); }
+		const uint8_t* Next(uint8_t* scratch, size_t length) { return file_.Next(scratch, length); }
+		bool Seek(size_t offset) { return file_.Seek(offset); }
+		void DropConsumed() { file_.DropConsumed(); }
+
+	   private:
+		SequentialFile file_;
+	};
+};
+
+/**
+ * @brief I/O policy: decrypts ciphertext already in memory, such as an embedded model, where it
+ * lies. No system call is made.
+ */
+template <size_t IoChunkSize = 256 * 1024>
+struct MemoryIo {
+	using Source = EmbeddedModel;
+	static constexpr size_t kIoChunkSize = IoChunkSize;
+	static constexpr bool kDropPageCache = false;
+
+	class Reader {
+	   public:
+		bool Open(const Source& source) {
+			data_ = static_cast<const uint8_t*>(source.data);
+			size_ = source.size;
+			offset_ = 0;
+			return data_ != nullptr || size_ == 0;
+		}
+		size_t size() const { return size_; }
+		bool Read(void* out, size_t length) {
+			if (length > size_ - offset_) {
+				return false;
+			}
+			if (length != 0) {
+				std::memcpy(out, data_ + offset_, length);
+			}
+			offset_ += length;
+			return true;
+		}
+		const uint8_t* Next(uint8_t*, size_t length) {
+			if (length > size_ - offset_) {
+				return nullptr;
+			}
+			offset_ += length;
+			return data_ + offset_ - length;
+		}
+		bool Seek(size_t offset) {
+			offset_ = std::min(offset, size_);
+			return offset == offset_;
+		}
+		void DropConsumed() {}
+
+	   private:
+		const uint8_t* data_ = nullptr;
+		size_t size_ = 0;
+		size_t offset_ = 0;
+	};
+};
+
+/**
+ * @brief Decryption core with the cipher, the AES kernel, the chunk layout and the I/O strategy
+ * fixed at compile time.
+ *
+ * TFLiteModelProtector picks all of these at run time. This core is for builds that know their
+ * target. The decrypt loop calls one AES kernel directly, and the step and chunk sizes are
+ * constants, so chunk boundaries cost no bookkeeping. It does no tracing, locking or allocation.
+ * Files are validated exactly like TFLiteModelProtector validates them, but a file whose cipher
+ * does not match `CipherPolicy` is rejected with kBadHeader. Failures are reported by status()
+ * and counted in ProtectorMetrics.
+ *
+ * @code
+ *   using BootProtector = BasicModelProtector<AesCbcPolicy<AesPath::kAesNi, true>, MemoryIo<>>;
+ *   BootProtector protector(key, iv);
+ *   protector.Open(TFLITE_EMBEDDED_MODEL(detector_model));
+ *   protector.Decrypt(buffer, capacity, &model_size);
+ * @endcode
+ */
+template <typename CipherPolicy, typename IoPolicy>
+class BasicModelProtector {
+   public:
+	using Source = typename IoPolicy::Source;
+	static constexpr size_t kBlockSize = AesCbcDecryptor::kBlockSize;
+	static constexpr size_t kKeyLength = 32;
+	static constexpr size_t kIvLength = 16;
+
+	static_assert(IoPolicy::kIoChunkSize > 0 && IoPolicy::kIoChunkSize % kBlockSize == 0,
+				  "I/O steps must be whole cipher blocks");
+	static_assert(CipherPolicy::kChunkSize == 0 ||
+					  IoPolicy::kIoChunkSize % CipherPolicy::kChunkSize == 0,
+				  "I/O steps must be whole chunks, so every step starts a chunk");
+
+	/**
+	 * @throws std::invalid_argument If the size of the key or IV is wrong.
+	 */
+	BasicModelProtector(const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv) {
+		if (key.size() != kKeyLength || iv.size() != kIvLength) {
+			throw std::invalid_argument("Invalid key or IV length");
+		}
+		std::memcpy(key_, key.data(), kKeyLength);
+		std::memcpy(iv_, iv.data(), kIvLength);
+	}
+
+	~BasicModelProtector() {
+		OPENSSL_cleanse(key_, sizeof(key_));
+		OPENSSL_cleanse(iv_, sizeof(iv_));
+	}
+
+	BasicModelProtector(const BasicModelProtector&) = delete;
+	BasicModelProtector& operator=(const BasicModelProtector&) = delete;
+
+	// Whether this CPU has the AES kernel CipherPolicy names.
+	static bool Supported() { return CipherPolicy::kPath <= CpuFeatures::Get().aes_path; }
+
+	/**
+	 * @brief Opens `source` and validates it before any of the body is read.
+	 *
+	 * On success plaintext_capacity() tells how large the Decrypt() buffer must be.
+	 */
+	bool Open(const Source& source) {
+		status_ = ProtectorStatus::kOk;
+		body_size_ = 0;
+		if (!Supported()) {
+			return Fail(ProtectorStatus::kCipherError);
+		}
+		if (!reader_.Open(source)) {
+			return Fail(ProtectorStatus::kFileOpenError);
+		}
+
+		const size_t size = reader_.size();
+		uint8_t header_bytes[ModelHeader::kSize] = {};
+		const size_t header_read = std::min(size, ModelHeader::kSize);
+		if (!reader_.Read(header_bytes, header_read)) {
+			return Fail(ProtectorStatus::kIoError);
+		}
+		has_header_ = ModelHeader::HasMagic(header_bytes, header_read);
+		if (!has_header_) {
+			if (CipherPolicy::kChunkSize != 0) {
+				return Fail(ProtectorStatus::kBadHeader);  // Legacy files are never chunked
+			}
+			if (size == 0 || size % kBlockSize != 0) {
+				return Fail(ProtectorStatus::kTruncated);
+			}
+			reader_.Seek(0);
+			body_size_ = size;
+			capacity_ = size;
+			return true;
+		}
+
+		if (!ModelHeader::Parse(header_bytes, header_read, &header_) ||
+			header_.cipher != CipherPolicy::kCipher) {
+			return Fail(ProtectorStatus::kBadHeader);
+		}
+		uint8_t key_check[ModelHeader::kKeyCheckLength];
+		if (!ModelHeader::ComputeKeyCheck(key_, iv_, key_check) ||
+			CRYPTO_memcmp(key_check, header_.key_check, sizeof(key_check)) != 0) {
+			return Fail(ProtectorStatus::kWrongKey);
+		}
+		if (size - ModelHeader::kSize != ModelHeader::CipherSize(header_.plaintext_size)) {
+			return Fail(ProtectorStatus::kTruncated);
+		}
+		body_size_ = size - ModelHeader::kSize;
+		capacity_ = static_cast<size_t>(header_.plaintext_size);
+		return true;
+	}
+
+	/**
+	 * @brief Decrypts the opened source into `out`.
+	 *
+	 * @return true on success. On failure status() tells why and `out` has been wiped.
+	 */
+	bool Decrypt(void* out, size_t capacity, size_t* plain_size) {
+		if (body_size_ == 0) {
+			// Not opened, or Open() failed and already said why.
+			return status_ == ProtectorStatus::kOk ? Fail(ProtectorStatus::kIoError) : false;
+		}
+		if (capacity < capacity_) {
+			return Fail(ProtectorStatus::kBufferTooSmall);
+		}
+		uint8_t* const dst = static_cast<uint8_t*>(out);
+		const bool ok = DecryptBody(dst, plain_size);
+		if (!ok) {
+			OPENSSL_cleanse(dst, capacity_);
+		}
+		body_size_ = 0;	 // The reader is spent; Open() again to decrypt again
+		return ok;
+	}
+
+	size_t plaintext_capacity() const { return capacity_; }
+	ProtectorStatus status() const { return status_; }
+
+   private:
+	static constexpr size_t kChunkSize = CipherPolicy::kChunkSize;
+	static constexpr size_t kDropInterval = 16 * IoPolicy::kIoChunkSize;
+
+	bool DecryptBody(uint8_t* out, size_t* plain_size) {
+		const auto start = std::chrono::steady_clock::now();
+		AesCbcDecryptor decryptor(key_, iv_, CipherPolicy::kPath);
+		std::optional<ChunkIvDeriver> ivs;
+		if constexpr (kChunkSize != 0) {
+			ivs.emplace(key_, iv_);
+		}
+		const size_t bulk_size = body_size_ - kBlockSize;
+		const bool hash = has_header_ && header_.has_content_digest();
+		Xxh3Hasher hasher;
+
+		for (size_t offset = 0; offset < bulk_size;) {
+			const size_t length = std::min(IoPolicy::kIoChunkSize, bulk_size - offset);
+			const uint8_t* cipher = reader_.Next(out + offset, length);
+			if (cipher == nullptr) {
+				return Fail(ProtectorStatus::kIoError);
+			}
+			bool ok = true;
+			if constexpr (kChunkSize == 0) {
+				ok = decryptor.DecryptBlocksWith<CipherPolicy::kPath>(cipher, out + offset,
+																	  length / kBlockSize);
+			} else {
+				for (size_t pos = 0; ok && pos < length; pos += kChunkSize) {
+					ok = StartChunk(decryptor, *ivs, (offset + pos) / kChunkSize) &&
+						 decryptor.DecryptBlocksWith<CipherPolicy::kPath>(
+							 cipher + pos, out + offset + pos,
+							 std::min(kChunkSize, length - pos) / kBlockSize);
+				}
+			}
+			if (!ok) {
+				return Fail(ProtectorStatus::kCipherError);
+			}
+			if (hash) {
+				hasher.Update(out + offset, length);
+			}
+			offset += length;
+			if constexpr (IoPolicy::kDropPageCache) {
+				if (offset % kDropInterval == 0) {
+					reader_.DropConsumed();
+				}
+			}
+		}
+
+		uint8_t last[kBlockSize];
+		if (!reader_.Read(last, sizeof(last))) {
+			return Fail(ProtectorStatus::kIoError);
+		}
+		if constexpr (IoPolicy::kDropPageCache) {
+			reader_.DropConsumed();
+		}
+		bool ok = true;
+		if constexpr (kChunkSize != 0) {
+			// A body ending on a chunk boundary pads into a chunk of its own.
+			if (bulk_size % kChunkSize == 0) {
+				ok = StartChunk(decryptor, *ivs, bulk_size / kChunkSize);
+			}
+		}
+		if (!ok || !decryptor.DecryptBlocksWith<CipherPolicy::kPath>(last, last, 1)) {
+			OPENSSL_cleanse(last, sizeof(last));
+			return Fail(ProtectorStatus::kCipherError);
+		}
+		size_t tail = 0;
+		ok = StripPadding(last, &tail) && bulk_size + tail <= capacity_ &&
+			 (!has_header_ || bulk_size + tail == header_.plaintext_size);
+		if (ok) {
+			std::memcpy(out + bulk_size, last, tail);
+		}
+		OPENSSL_cleanse(last, sizeof(last));
+		if (!ok) {
+			return Fail(ProtectorStatus::kWrongKey);
+		}
+		if (hash) {
+			hasher.Update(out + bulk_size, tail);
+			if (hasher.Digest() != header_.content_digest) {
+				return Fail(ProtectorStatus::kChecksumMismatch);
+			}
+		}
+		*plain_size = bulk_size + tail;
+		ProtectorMetrics::Instance().RecordDecrypt(*plain_size,
+												   std::chrono::steady_clock::now() - start);
+		return true;
+	}
+
+	static bool StartChunk(AesCbcDecryptor& decryptor, ChunkIvDeriver& ivs, uint64_t index) {
+		uint8_t chunk_iv[kBlockSize];
+		if (!ivs.Derive(index, chunk_iv)) {
+			return false;
+		}
+		decryptor.SetChainingValue(chunk_iv);
+		return true;
+	}
+
+	// Checks PKCS#7 padding without branching on the padding bytes.
+	static bool StripPadding(const uint8_t* block, size_t* length) {
+		const uint8_t pad = block[kBlockSize - 1];
+		uint8_t bad = static_cast<uint8_t>(pad == 0 || pad > kBlockSize);
+		for (size_t i = 0; i < kBlockSize; ++i) {
+			const uint8_t in_pad = static_cast<uint8_t>(i + pad >= kBlockSize);
+			bad |= static_cast<uint8_t>(in_pad & static_cast<uint8_t>(block[i] != pad));
+		}
+		*length = kBlockSize - std::min<size_t>(pad, kBlockSize);
+		return bad == 0;
+	}
+
+	bool Fail(ProtectorStatus status) {
+		status_ = status;
+		ProtectorMetrics::Instance().RecordFailure(status);
+		return false;
+	}
+
+	uint8_t key_[kKeyLength] = {};
+	uint8_t iv_[kIvLength] = {};
+	typename IoPolicy::Reader reader_;
+	bool has_header_ = false;
+	ModelHeader header_;
+	size_t body_size_ = 0;	// Bytes of CBC ciphertext after the header; 0 until opened
+	size_t capacity_ = 0;
+	ProtectorStatus status_ = ProtectorStatus::kOk;
+};
+
+#endif	// TFLITE_BASIC_MODEL_PROTECTOR_H_
@@ -0,0 +1,13 @@
+#ifndef TFLITE_CGROUP_H_
+#define TFLITE_CGROUP_H_
+
+#include <cstddef>
+#include <string>
+
+std::string OwnCgroupDir();
+
+// CPUs this process can use: its affinity mask, capped by the cpu.max quota of its cgroup and
+// every ancestor, rounded up. At least 1.
+size_t EffectiveCpuCount();
+
+#endif	// TFLITE_CGROUP_H_
@@ -0,0 +1,40 @@
+#ifndef TFLITE_CONTENT_HASH_H_
+#define TFLITE_CONTENT_HASH_H_
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Streaming XXH3-64 (seed 0, default secret), bit-compatible with the reference xxHash.
+ *
+ * Used as the plaintext content digest in ModelHeader. The stripe accumulator runs on AVX2 when
+ * available and on a portable scalar loop otherwise; both produce identical digests. Feeding the
+ * data in any split gives the same digest as one Hash() call over the whole input.
+ */
+class Xxh3Hasher {
+   public:
+	Xxh3Hasher();
+
+	void Update(const void* data, size_t length);
+	uint64_t Digest() const;
+
+	static uint64_t Hash(const void* data, size_t length);
+
+   private:
+	static constexpr size_t kStripeLength = 64;
+	static constexpr size_t kBufferSize = 256;	// Four stripes
+	static constexpr size_t kMidSizeMax = 240;	// Inputs up to this size use the short paths
+
+	void ConsumeStripes(uint64_t* acc, size_t* stripes_in_block, const uint8_t* input,
+						size_t stripes) const;
+
+	alignas(32) uint64_t acc_[8];
+	alignas(32) uint8_t buffer_[kBufferSize];
+	uint8_t last_stripe_[kStripeLength];  // The stripe before buffer_, once any are consumed
+	size_t buffered_ = 0;
+	size_t stripes_in_block_ = 0;
+	uint64_t total_length_ = 0;
+	bool use_avx2_ = false;
+};
+
+#endif	// TFLITE_CONTENT_HASH_H_
@@ -0,0 +1,33 @@
+#ifndef TFLITE_CPU_FEATURES_H_
+#define TFLITE_CPU_FEATURES_H_
+
+/**
+ * @brief AES implementation used for bulk CBC decryption.
+ */
+enum class AesPath {
+	kPortable,	// OpenSSL EVP, whatever that build dispatches to
+	kAesNi,		// 128-bit AES-NI, 8 blocks in flight
+	kVaes256,	// VAES on ymm registers, 8 blocks in flight
+	kVaes512,	// VAES on zmm registers (AVX-512), 16 blocks in flight
+};
+
+const char* AesPathName(AesPath path);
+
+/**
+ * @brief CPU features detected once when the library is loaded.
+ *
+ * The AES path defaults to the widest kernel the CPU and OS support. Setting the environment
+ * variable TFLITE_PROTECTOR_AES_PATH to portable, aesni, vaes256 or vaes512 selects a narrower
+ * path, which is useful for benchmarking; requests for unsupported paths are ignored.
+ */
+struct CpuFeatures {
+	bool aes = false;
+	bool avx2 = false;
+	bool avx512f = false;
+	bool vaes = false;
+	AesPath aes_path = AesPath::kPortable;
+
+	static const CpuFeatures& Get();
+};
+
+#endif	// TFLITE_CPU_FEATURES_H_
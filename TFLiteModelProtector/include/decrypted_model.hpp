@@ -0,0 +1,62 @@
+#ifndef TFLITE_DECRYPTED_MODEL_H_
+#define TFLITE_DECRYPTED_MODEL_H_
+
+#include <tensorflow/lite/model.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "model_buffer.hpp"
+
+/**
+ * @brief Move-only result of TFLiteModelProtector::LoadDecryptedModel().
+ *
+ * Owns the decrypted plaintext and the FlatBufferModel built on top of it, together with what is
+ * known about the load. Moving it transfers both allocations at pointer cost; the model keeps
+ * pointing at the same plaintext, so it can be handed between registries, caches and threads
+ * freely. The plaintext is released (and wiped, for BufferPolicy::kLockedArena) only after the
+ * model is destroyed.
+ */
+class DecryptedModel {
+   public:
+	struct Timings {
+		std::chrono::nanoseconds decrypt{0};  // Open, allocate, read, decrypt and verify
+		std::chrono::nanoseconds build{0};	  // FlatBufferModel::BuildFromBuffer()
+	};
+
+	DecryptedModel() = default;
+	~DecryptedModel() = default;
+
+	DecryptedModel(DecryptedModel&& other) noexcept = default;
+	DecryptedModel& operator=(DecryptedModel&& other) noexcept;
+	DecryptedModel(const DecryptedModel&) = delete;
+	DecryptedModel& operator=(const DecryptedModel&) = delete;
+
+	explicit operator bool() const { return model_ != nullptr; }
+
+	const tflite::FlatBufferModel* model() const { return model_.get(); }
+	const tflite::FlatBufferModel& operator*() const { return *model_; }
+	const tflite::FlatBufferModel* operator->() const { return model_.get(); }
+
+	const char* data() const { return buffer_.data(); }
+	size_t size() const { return buffer_.size(); }
+	const ModelBuffer& buffer() const { return buffer_; }
+
+	const std::string& source() const { return source_; }
+	uint64_t content_digest() const { return content_digest_; }	// XXH3-64 of the plaintext
+	const Timings& timings() const { return timings_; }
+
+   private:
+	friend class TFLiteModelProtector;
+
+	// Declared before model_ so that it is destroyed after it.
+	ModelBuffer buffer_;
+	std::unique_ptr<tflite::FlatBufferModel> model_;
+	std::string source_;
+	uint64_t content_digest_ = 0;
+	Timings timings_;
+};
+
+#endif	// TFLITE_DECRYPTED_MODEL_H_
@@ -0,0 +1,27 @@
+#ifndef TFLITE_EMBEDDED_MODEL_H_
+#define TFLITE_EMBEDDED_MODEL_H_
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief An encrypted model linked into the executable by tflite_protect_embed().
+ *
+ * The ciphertext lives in .rodata, so it is mapped with the executable and loading it opens no
+ * file. Build one with TFLITE_EMBEDDED_MODEL() and pass it to
+ * TFLiteModelProtector::LoadEmbeddedModel().
+ */
+struct EmbeddedModel {
+	const void* data = nullptr;
+	size_t size = 0;
+};
+
+// Declares the symbols tflite_protect_embed() generated for NAME. Use at namespace scope.
+#define TFLITE_DECLARE_EMBEDDED_MODEL(name) \
+	extern "C" const unsigned char name[];  \
+	extern "C" const uint64_t name##_size
+
+#define TFLITE_EMBEDDED_MODEL(name) \
+	EmbeddedModel { name, static_cast<size_t>(name##_size) }
+
+#endif	// TFLITE_EMBEDDED_MODEL_H_
@@ -0,0 +1,51 @@
+#ifndef TFLITE_LOCKED_ARENA_H_
+#define TFLITE_LOCKED_ARENA_H_
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief Pool of mlock()ed memory that decrypted model buffers are carved from.
+ *
+ * Regions are mapped, locked and marked MADV_DONTDUMP / MADV_DONTFORK once, then reused across
+ * loads, so plaintext never reaches swap, core dumps or forked children. Blocks are wiped when
+ * they are returned; whole regions are wiped and unlocked only when they are trimmed.
+ */
+class LockedArena {
+   public:
+	static constexpr size_t kDefaultRegionSize = 64 * 1024 * 1024;
+	static constexpr size_t kBlockAlignment = 4096;
+
+	explicit LockedArena(size_t region_size = kDefaultRegionSize);
+	~LockedArena();
+
+	LockedArena(const LockedArena&) = delete;
+	LockedArena& operator=(const LockedArena&) = delete;
+
+	static LockedArena& Instance();
+
+	char* Acquire(size_t size);
+	void Return(char* block, size_t size);
+	void Trim();
+
+	void SetRegionSize(size_t region_size);
+	size_t locked_bytes() const;
+
+   private:
+	struct Region {
+		char* base = nullptr;
+		size_t length = 0;
+		std::map<char*, size_t> free_blocks;  // start address -> length, coalesced on return
+	};
+
+	Region* MapRegion(size_t min_length);
+	static void UnmapRegion(Region& region);
+
+	mutable std::mutex mutex_;
+	size_t region_size_;
+	std::vector<Region> regions_;
+};
+
+#endif	// TFLITE_LOCKED_ARENA_H_
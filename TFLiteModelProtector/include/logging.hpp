@@ -0,0 +1,13 @@
+#ifndef TFLITE_LOGGING_H_
+#define TFLITE_LOGGING_H_
+
+#include <iostream>
+
+#define ENABLE_LOGGING_LINUX  // Comment out this line to disable linux logging
+
+#ifdef ENABLE_LOGGING_LINUX
+#define LOGE(msg) std::cerr << "TFLiteModelProtector: " << msg << std::endl;
+#define LOGI(msg) std::cout << "TFLiteModelProtector: " << msg << std::endl;
+#endif
+
+#endif	// TFLITE_LOGGING_H_
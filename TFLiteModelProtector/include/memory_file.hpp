@@ -0,0 +1,37 @@
+#ifndef TFLITE_MEMORY_FILE_H_
+#define TFLITE_MEMORY_FILE_H_
+
+#include <cstddef>
+#include <string>
+
+/**
+ * @brief Move-only anonymous in-memory file (memfd) for plaintext that a library insists on
+ * reading from a path, such as the XNNPACK weight cache.
+ *
+ * The contents live in RAM only and disappear when the file is closed. path() names the file as
+ * /proc/self/fd/<fd>, which can be opened, written and mapped like a regular file by this process
+ * and is inherited by no child (the descriptor is close-on-exec).
+ */
+class MemoryFile {
+   public:
+	MemoryFile() = default;
+	~MemoryFile();
+
+	MemoryFile(MemoryFile&& other) noexcept;
+	MemoryFile& operator=(MemoryFile&& other) noexcept;
+	MemoryFile(const MemoryFile&) = delete;
+	MemoryFile& operator=(const MemoryFile&) = delete;
+
+	bool Create(const char* name);
+	void Close();
+
+	int fd() const { return fd_; }
+	bool valid() const { return fd_ >= 0; }
+	std::string path() const;
+	size_t size() const;
+
+   private:
+	int fd_ = -1;
+};
+
+#endif	// TFLITE_MEMORY_FILE_H_
@@ -0,0 +1,115 @@
+#ifndef TFLITE_MEMORY_GOVERNOR_H_
+#define TFLITE_MEMORY_GOVERNOR_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/**
+ * @brief Memory state of a cgroup v2 group.
+ */
+struct MemorySnapshot {
+	uint64_t working_set = 0;  // memory.current minus inactive file pages, which reclaim for free
+	uint64_t limit = 0;		   // memory.max, 0 if unlimited
+	double pressure = 0;	   // PSI "some avg10": % of the last 10 s some task stalled on memory
+};
+
+/**
+ * @brief Admits model loads against the cgroup's memory budget and evicts caches under pressure.
+ *
+ * Before a load allocates its plaintext buffer it asks Admit() for that many bytes. The load
+ * goes ahead if the working set, plus what other admitted loads are about to allocate, stays
+ * within the budget and memory pressure is below the threshold. Otherwise the governor asks the
+ * registered reclaimers (such as ModelCache) to drop least recently used models, then waits for
+ * memory to free up, and finally rejects the load. A slow load is better than an OOM kill.
+ *
+ * Without cgroup v2 files the governor only enforces an explicit budget_bytes against the sum of
+ * admitted loads, or admits everything.
+ */
+class MemoryGovernor {
+   public:
+	struct Options {
+		std::string cgroup_dir;		 // Empty: this process's cgroup under /sys/fs/cgroup
+		uint64_t budget_bytes = 0;	 // 0: memory.max less the headroom
+		double headroom = 0.10;		 // Fraction of memory.max kept free for everything else
+		double max_pressure = 10.0;	 // PSI some avg10 above which loads wait
+		std::chrono::milliseconds max_defer{5000};
+		std::chrono::milliseconds poll_interval{50};
+	};
+
+	// Frees up to `wanted` bytes and returns how many it freed.
+	using Reclaimer = std::function<uint64_t(uint64_t wanted)>;
+
+	/**
+	 * @brief Bytes admitted for one load; returned to the governor when destroyed.
+	 */
+	class Reservation {
+	   public:
+		Reservation() = default;
+		~Reservation() { Reset(); }
+		Reservation(Reservation&& other) noexcept;
+		Reservation& operator=(Reservation&& other) noexcept;
+		Reservation(const Reservation&) = delete;
+		Reservation& operator=(const Reservation&) = delete;
+
+		explicit operator bool() const { return governor_ != nullptr; }
+		void Reset();
+
+	   private:
+		friend class MemoryGovernor;
+		Reservation(MemoryGovernor* governor, uint64_t bytes)
+			: governor_(governor), bytes_(bytes) {}
+
+		MemoryGovernor* governor_ = nullptr;
+		uint64_t bytes_ = 0;
+	};
+
+	MemoryGovernor();
+	explicit MemoryGovernor(const Options& options);
+	~MemoryGovernor();
+
+	MemoryGovernor(const MemoryGovernor&) = delete;
+	MemoryGovernor& operator=(const MemoryGovernor&) = delete;
+
+	bool ReadSnapshot(MemorySnapshot* snapshot) const;
+	Reservation Admit(uint64_t bytes);
+	uint64_t Rebalance();
+
+	int AddReclaimer(Reclaimer reclaimer);
+	void RemoveReclaimer(int id);
+
+	void StartMonitor(std::chrono::milliseconds interval);
+	void StopMonitor();
+
+	const std::string& cgroup_dir() const { return cgroup_dir_; }
+	uint64_t reserved() const;
+
+   private:
+	uint64_t Budget(const MemorySnapshot& snapshot) const;
+	uint64_t Shortfall(const MemorySnapshot& snapshot, uint64_t bytes) const;
+	uint64_t Reclaim(uint64_t wanted);
+	void Release(uint64_t bytes);
+
+	const Options options_;
+	std::string cgroup_dir_;
+
+	mutable std::mutex mutex_;
+	std::condition_variable released_;
+	uint64_t reserved_ = 0;	 // Admitted but possibly not yet allocated
+
+	std::mutex reclaim_mutex_;
+	std::map<int, Reclaimer> reclaimers_;
+	int next_reclaimer_ = 0;
+
+	std::mutex monitor_mutex_;
+	std::condition_variable monitor_wakeup_;
+	std::thread monitor_;
+	bool monitor_stop_ = false;
+};
+
+#endif	// TFLITE_MEMORY_GOVERNOR_H_
@@ -0,0 +1,65 @@
+#ifndef TFLITE_MODEL_BUFFER_H_
+#define TFLITE_MODEL_BUFFER_H_
+
+#include <cstddef>
+
+/**
+ * @brief Backing store used for decrypted model buffers.
+ *
+ * kHeap keeps the historic behaviour (ordinary 4 KB pages). The huge page policies place the
+ * plaintext in a 2 MB aligned anonymous mapping so that inference touches far fewer TLB entries.
+ * kLockedArena keeps the plaintext out of swap and core dumps; it never falls back to unlocked
+ * memory.
+ */
+enum class BufferPolicy {
+	kHeap,					// 64-byte aligned heap allocation
+	kTransparentHugePages,	// 2 MB aligned anonymous mapping advised with MADV_HUGEPAGE
+	kHugeTlbFs,				// explicit MAP_HUGETLB mapping, falls back to THP when unavailable
+	kLockedArena,			// mlock()ed, non-dumpable block from LockedArena::Instance()
+};
+
+/**
+ * @brief Move-only owner of a decrypted model allocation.
+ *
+ * The capacity is fixed by Allocate() and the decryptor writes straight into data(); size() is
+ * the number of valid plaintext bytes.
+ */
+class ModelBuffer {
+   public:
+	static constexpr size_t kHugePageSize = 2 * 1024 * 1024;
+	static constexpr size_t kHeapAlignment = 64;
+
+	ModelBuffer() = default;
+	~ModelBuffer();
+
+	ModelBuffer(ModelBuffer&& other) noexcept;
+	ModelBuffer& operator=(ModelBuffer&& other) noexcept;
+	ModelBuffer(const ModelBuffer&) = delete;
+	ModelBuffer& operator=(const ModelBuffer&) = delete;
+
+	bool Allocate(size_t capacity, BufferPolicy policy = BufferPolicy::kHeap,
+				  bool prefault = false, int numa_node = -1);
+	void Release();
+	void Resize(size_t size);
+
+	char* data() { return data_; }
+	const char* data() const { return data_; }
+	size_t size() const { return size_; }
+	size_t capacity() const { return capacity_; }
+	bool empty() const { return size_ == 0; }
+	BufferPolicy policy() const { return policy_; }
+	int numa_node() const { return numa_node_; }  // The node the pages are bound to, or -1
+
+   private:
+	bool MapPages(size_t capacity, BufferPolicy policy, bool prefault, int numa_node);
+
+	char* data_ = nullptr;
+	size_t size_ = 0;
+	size_t capacity_ = 0;
+	size_t mapped_length_ = 0;	// Non-zero when data_ comes from mmap rather than the heap
+	bool from_arena_ = false;	// data_ was acquired from LockedArena::Instance()
+	BufferPolicy policy_ = BufferPolicy::kHeap;
+	int numa_node_ = -1;
+};
+
+#endif	// TFLITE_MODEL_BUFFER_H_
@@ -0,0 +1,67 @@
+#ifndef TFLITE_MODEL_CACHE_H_
+#define TFLITE_MODEL_CACHE_H_
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "memory_governor.hpp"
+#include "model_protector.hpp"
+
+/**
+ * @brief Keeps recently used decrypted models resident, up to a byte capacity.
+ *
+ * Get() returns the cached model while the file on disk is unchanged, and otherwise loads it
+ * through TFLiteModelProtector::LoadSharedModel(), so concurrent misses decrypt once. Beyond the
+ * capacity, least recently used models are dropped. With a MemoryGovernor the cache also gives
+ * up models the rest of the process no longer holds whenever the governor needs memory.
+ *
+ * Eviction only drops the cache's reference; a model still in use stays alive until its last
+ * holder releases it.
+ */
+class ModelCache {
+   public:
+	ModelCache(TFLiteModelProtector& protector, uint64_t capacity_bytes,
+			   std::shared_ptr<MemoryGovernor> governor = nullptr);
+	~ModelCache();
+
+	ModelCache(const ModelCache&) = delete;
+	ModelCache& operator=(const ModelCache&) = delete;
+
+	std::shared_ptr<const DecryptedModel> Get(const std::string& model_path);
+	uint64_t Evict(uint64_t bytes);
+	void Clear();
+
+	uint64_t resident_bytes() const;
+	size_t size() const;
+
+   private:
+	struct Entry {
+		std::string path;
+		uint64_t inode = 0;
+		uint64_t file_size = 0;
+		int64_t mtime_ns = 0;
+		std::shared_ptr<const DecryptedModel> model;
+	};
+	using Lru = std::list<Entry>;  // Most recently used first
+
+	uint64_t EvictLocked(uint64_t bytes, bool unused_only);
+	uint64_t EraseLocked(Lru::iterator it);
+
+	TFLiteModelProtector& protector_;
+	const uint64_t capacity_bytes_;
+	std::shared_ptr<MemoryGovernor> governor_;
+	int reclaimer_id_ = -1;
+
+	mutable std::mutex mutex_;
+	Lru lru_;
+	std::unordered_map<std::string, Lru::iterator> index_;
+	// Entries per model: deduplicated loads of different paths share one model.
+	std::unordered_map<const DecryptedModel*, size_t> holders_;
+	uint64_t resident_bytes_ = 0;
+};
+
+#endif	// TFLITE_MODEL_CACHE_H_
@@ -0,0 +1,45 @@
+#ifndef TFLITE_MODEL_DEDUPLICATOR_H_
+#define TFLITE_MODEL_DEDUPLICATOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "decrypted_model.hpp"
+
+/**
+ * @brief Process-wide content-addressed table of shared decrypted models.
+ *
+ * Models are keyed by the XXH3 digest of their plaintext. That digest is computed during
+ * decryption, never taken from a file header. A digest match is only a candidate: the plaintext
+ * is compared byte for byte before a load is pointed at another load's buffer. So the same base
+ * model, encrypted under different names or keys, is kept in memory once however many tenants
+ * load it.
+ *
+ * The table holds no ownership. An entry disappears when the last holder releases its model.
+ */
+class ModelDeduplicator {
+   public:
+	static ModelDeduplicator& Instance();
+
+	std::shared_ptr<const DecryptedModel> Intern(DecryptedModel model, bool* shared = nullptr);
+
+	size_t size() const;
+
+   private:
+	struct Entry {
+		const DecryptedModel* model;
+		std::weak_ptr<const DecryptedModel> handle;
+	};
+
+	ModelDeduplicator() = default;
+
+	void Forget(uint64_t digest, const DecryptedModel* model);
+
+	mutable std::mutex mutex_;
+	std::unordered_multimap<uint64_t, Entry> entries_;
+};
+
+#endif	// TFLITE_MODEL_DEDUPLICATOR_H_
@@ -0,0 +1,110 @@
+#ifndef TFLITE_MODEL_FORMAT_H_
+#define TFLITE_MODEL_FORMAT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+/**
+ * @brief Outcome of the last protector operation on the calling thread.
+ */
+enum class ProtectorStatus {
+	kOk,
+	kFileOpenError,
+	kIoError,
+	kBadHeader,		 // Unknown version or cipher
+	kWrongKey,		 // Key check value mismatch, or bad padding in a legacy file
+	kTruncated,		 // File size disagrees with the header or the block size
+	kCipherError,	 // OpenSSL reported an error
+	kAllocationError,
+	kChecksumMismatch,	// Decrypted content does not match the digest in the header
+	kBufferTooSmall,	// Caller-provided buffer is smaller than RequiredBufferSize()
+	kInvalidModel,		// Plaintext is not a TFLite FlatBuffer
+	kMemoryPressure,	// The memory governor deferred the load for too long
+	kCancelled,			// The operation's CancellationToken was cancelled
+	kDeadlineExceeded,	// The operation's deadline passed before it finished
+};
+
+// Number of ProtectorStatus values, for tables indexed by status. Keep in step with the enum.
+constexpr size_t kProtectorStatusCount =
+	static_cast<size_t>(ProtectorStatus::kDeadlineExceeded) + 1;
+
+const char* ProtectorStatusName(ProtectorStatus status);
+
+/**
+ * @brief Fixed 32-byte header written in front of the AES-256-CBC stream.
+ *
+ * Layout, little-endian:
+ *   0  magic "TFMP"          4  version           5  cipher id        6  flags (u16)
+ *   8  plaintext size (u64) 16  key check value  24  content digest (u64)
+ *
+ * The key check value is the first 8 bytes of AES-256-ECB(key, iv ^ kKeyCheckTweak), which lets
+ * a wrong key or IV be rejected before any of the body is read. When kFlagContentDigest is set,
+ * the content digest is the XXH3-64 of the plaintext and is checked after decryption. Files
+ * without the magic are treated as legacy bare CBC streams.
+ *
+ * With kCipherAes256CbcChunked the body is cut into kChunkSize pieces, each CBC-chained from its
+ * own IV, AES-256-ECB(key, iv ^ tweak ^ index) (see ChunkIvDeriver). Only the last chunk is
+ * padded. Identical plaintext chunks at the same index encrypt identically under the same key,
+ * which is what lets CreateDelta() find changed chunks without the key.
+ */
+struct ModelHeader {
+	static constexpr size_t kSize = 32;
+	static constexpr size_t kKeyCheckLength = 8;
+	static constexpr uint8_t kVersion = 1;
+	static constexpr uint8_t kCipherAes256Cbc = 1;
+	static constexpr uint8_t kCipherAes256CbcChunked = 2;
+	static constexpr size_t kChunkSize = 64 * 1024;
+	static constexpr uint16_t kFlagContentDigest = 1 << 0;
+	// Largest plaintext_size Parse() accepts: CipherSize() of it still fits in a size_t.
+	static constexpr uint64_t kMaxPlaintextSize = std::numeric_limits<size_t>::max() - 16;
+
+	uint8_t version = kVersion;
+	uint8_t cipher = kCipherAes256Cbc;
+	uint16_t flags = 0;
+	uint64_t plaintext_size = 0;
+	uint8_t key_check[kKeyCheckLength] = {};
+	uint64_t content_digest = 0;
+
+	void Serialize(uint8_t* out) const;
+	static bool HasMagic(const uint8_t* in, size_t length);
+	static bool Parse(const uint8_t* in, size_t length, ModelHeader* header);
+
+	static bool ComputeKeyCheck(const uint8_t* key, const uint8_t* iv, uint8_t* key_check);
+	static size_t CipherSize(uint64_t plaintext_size);
+
+	bool has_content_digest() const { return (flags & kFlagContentDigest) != 0; }
+	bool is_chunked() const { return cipher == kCipherAes256CbcChunked; }
+	size_t chunk_size() const { return is_chunked() ? kChunkSize : 0; }
+	uint64_t chunk_count() const;
+};
+
+/**
+ * @brief Fixed 64-byte header of a delta file, followed by `chunk_count` changed chunks.
+ *
+ * Layout, little-endian:
+ *   0  magic "TFMD"          4  version          8  base plaintext size (u64)
+ *  16  base digest (u64)    24  chunk count (u64) 32  ModelHeader of the target file
+ *
+ * Each chunk record is its index (u64) followed by the target's ciphertext for that chunk,
+ * kChunkSize bytes except for the target's last chunk. Records are in ascending index order.
+ */
+struct DeltaHeader {
+	static constexpr size_t kSize = 64;
+	static constexpr uint8_t kVersion = 1;
+
+	uint8_t version = kVersion;
+	uint64_t base_size = 0;
+	uint64_t base_digest = 0;
+	uint64_t chunk_count = 0;
+	ModelHeader target;
+
+	void Serialize(uint8_t* out) const;
+	static bool Parse(const uint8_t* in, size_t length, DeltaHeader* header);
+
+	static constexpr size_t kIndexSize = 8;
+	static void SerializeIndex(uint64_t index, uint8_t* out);
+	static uint64_t ParseIndex(const uint8_t* in);
+};
+
+#endif	// TFLITE_MODEL_FORMAT_H_
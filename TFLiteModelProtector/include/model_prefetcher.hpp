@@ -0,0 +1,61 @@
+#ifndef TFLITE_MODEL_PREFETCHER_H_
+#define TFLITE_MODEL_PREFETCHER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "thread_policy.hpp"
+#include "work_stealing_pool.hpp"
+
+/**
+ * @brief Warms the page cache for encrypted models in the background.
+ *
+ * Queue the models an application is about to load at startup; by the time LoadEncryptedModel()
+ * reaches them their ciphertext is already cached, so decryption is no longer bound by storage
+ * latency. Prefetching is best effort: files that cannot be opened are skipped.
+ *
+ * The files are read by tasks on TaskExecutor::Default(), so prefetching adds no threads of its
+ * own.
+ */
+class ModelPrefetcher {
+   public:
+	enum class Mode {
+		kAdvise,  // posix_fadvise(WILLNEED): the kernel starts readahead and returns immediately
+		kRead,	  // Read every page, so the file is resident when Wait() returns
+	};
+
+	explicit ModelPrefetcher(Mode mode = Mode::kAdvise, size_t threads = 1,
+							 const ThreadPolicy& policy = ThreadPolicy::Background());
+	~ModelPrefetcher();
+
+	ModelPrefetcher(const ModelPrefetcher&) = delete;
+	ModelPrefetcher& operator=(const ModelPrefetcher&) = delete;
+
+	void Prefetch(const std::string& path);
+	void Prefetch(const std::vector<std::string>& paths);
+	void Wait();
+
+	uint64_t prefetched_bytes() const { return prefetched_bytes_.load(std::memory_order_relaxed); }
+
+   private:
+	void StartLanes();
+	void Drain();
+	void PrefetchFile(const std::string& path);
+
+	const Mode mode_;
+	const size_t max_lanes_;
+	TaskExecutor& executor_;
+	std::mutex mutex_;
+	std::condition_variable idle_;
+	std::deque<std::string> queue_;
+	size_t lanes_ = 0;	// Drain() tasks submitted and not yet finished
+	std::atomic<uint64_t> prefetched_bytes_{0};
+};
+
+#endif	// TFLITE_MODEL_PREFETCHER_H_
@@ -3,44 +3,198 @@
 
 #include <openssl/evp.h>
 #include <openssl/rand.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <tensorflow/lite/interpreter.h>
 #include <tensorflow/lite/kernels/register.h>
 #include <tensorflow/lite/model.h>
+#include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
+#include <future>
 #include <iostream>
 #include <memory>
+#include <memory_resource>
 #include <mutex>
+#include <sstream>
+#include <thread>
+#include <tuple>
 #include <vector>
 
-#define ENABLE_LOGGING_LINUX  // Comment out this line to disable linux logging
-
-#ifdef ENABLE_LOGGING_LINUX
-#define LOGE(msg) std::cerr << "TFLiteModelProtector: " << msg << std::endl;
-#define LOGI(msg) std::cout << "TFLiteModelProtector: " << msg << std::endl;
-#endif
+#include "aes_cbc.hpp"
+#include "basic_model_protector.hpp"
+#include "cgroup.hpp"
+#include "content_hash.hpp"
+#include "decrypted_model.hpp"
+#include "embedded_model.hpp"
+#include "logging.hpp"
+#include "memory_file.hpp"
+#include "memory_governor.hpp"
+#include "model_buffer.hpp"
+#include "model_deduplicator.hpp"
+#include "model_format.hpp"
+#include "model_prefetcher.hpp"
+#include "numa_placement.hpp"
+#include "operation_control.hpp"
+#include "protector_metrics.hpp"
+#include "sequential_file.hpp"
+#include "single_flight.hpp"
+#include "thread_policy.hpp"
+#include "trace_events.hpp"
+#include "work_stealing_pool.hpp"
 
 class TFLiteModelProtector {
    public:
 	static constexpr int kAesKeyLength = 32;  // 256-bit key
 	static constexpr int kAesIvLength = 16;	  // 128-bit IV
+	static constexpr size_t kIoChunkSize = 256 * 1024;	// Ciphertext read and decrypted per step
+	static constexpr size_t kPageCacheDropInterval = 16 * kIoChunkSize;
 
 	TFLiteModelProtector() = default;
 	~TFLiteModelProtector() = default;
 
 	bool EncryptFile(const std::string& input_file, const std::string& output_file);
-	void DecryptFileToMemory(const std::string& input_file, std::vector<char>& model_buffer);
+	bool VerifyEncryptedFile(const std::string& plain_file, const std::string& encrypted_file);
+	bool ReEncrypt(const std::string& input_file, const std::string& output_file,
+				   const std::vector<uint8_t>& new_key, const std::vector<uint8_t>& new_iv);
+	size_t ReEncryptFiles(const std::vector<std::string>& files,
+						  const std::vector<uint8_t>& new_key, const std::vector<uint8_t>& new_iv,
+						  size_t parallelism = 0);
+	static bool CreateDelta(const std::string& old_file, const std::string& new_file,
+							const std::string& delta_file, size_t* changed_chunks = nullptr);
+	static bool PatchEncryptedFile(const std::string& old_file, const std::string& delta_file,
+								   const std::string& new_file);
+	bool DecryptFileToMemory(const std::string& input_file, std::vector<char>& model_buffer);
+	bool DecryptFileToMemory(const std::string& input_file, ModelBuffer& model_buffer);
+	bool DecryptFileToMemory(const std::string& input_file, std::pmr::vector<char>& model_buffer);
+	bool DecryptFileToMemory(const std::string& input_file, void* buffer, size_t capacity,
+							 size_t* plain_size);
+	bool RequiredBufferSize(const std::string& input_file, size_t* size);
+	bool DecryptBufferToMemory(const void* ciphertext, size_t size, std::vector<char>& model_data);
+	bool DecryptBufferToMemory(const void* ciphertext, size_t size, ModelBuffer& model_buffer);
+	bool DecryptBufferInPlace(void* buffer, size_t size, char** model_data, size_t* model_size);
 	std::unique_ptr<tflite::FlatBufferModel> LoadModel(const std::vector<char>& model_data);
+	std::unique_ptr<tflite::FlatBufferModel> LoadModel(const ModelBuffer& model_data);
+	std::unique_ptr<tflite::FlatBufferModel> LoadModel(const void* model_data, size_t size);
 	std::unique_ptr<tflite::FlatBufferModel> LoadEncryptedModel(const std::string& model_path);
+	std::unique_ptr<tflite::FlatBufferModel> LoadEncryptedModelFromBuffer(const void* ciphertext,
+																		   size_t size);
+	std::unique_ptr<tflite::FlatBufferModel> LoadEncryptedModelInPlace(void* buffer, size_t size);
+	std::unique_ptr<tflite::FlatBufferModel> LoadEmbeddedModel(const EmbeddedModel& embedded);
+	std::shared_ptr<NumaReplicatedModel> LoadEncryptedModelReplicated(
+		const std::string& model_path);
+	DecryptedModel LoadDecryptedModel(const std::string& model_path);
+	std::future<DecryptedModel> LoadDecryptedModelAsync(const std::string& model_path);
+	std::shared_ptr<const DecryptedModel> LoadSharedModel(const std::string& model_path);
+	DecryptedModel ApplyDelta(const DecryptedModel& base, const std::string& delta_file);
+	bool OpenWeightCache(const std::string& encrypted_cache_file, MemoryFile& cache);
+	bool SaveWeightCache(const MemoryFile& cache, const std::string& encrypted_cache_file);
+	static std::string WeightCachePath(const std::string& model_path);
 	void GenerateKeyAndIv(std::vector<uint8_t>& key, std::vector<uint8_t>& iv);
 	void SetCustomKeyAndIv(const std::vector<uint8_t>& key, const std::vector<uint8_t>& iv);
+	void SetBufferPolicy(BufferPolicy policy, bool prefault = false);
+	void SetNumaNode(int node);
+	void SetDropPageCache(bool drop);
+	void SetChunkedFormat(bool chunked);
+	void SetWorkerPolicy(const ThreadPolicy& policy);
+	void SetExecutor(std::shared_ptr<TaskExecutor> executor);
+	void SetMemoryGovernor(std::shared_ptr<MemoryGovernor> governor);
+	void SetDeduplicateModels(bool deduplicate);
+
+	static ProtectorStatus LastStatus();
 
    private:
+	static inline const std::string kBufferName = "<memory>";  // Names in-memory input in logs
+
+	struct EncryptedFileInfo {
+		bool has_header = false;
+		ModelHeader header;
+		size_t body_size = 0;			  // Bytes of CBC ciphertext after the header
+		size_t plaintext_capacity = 0;	  // Exact with a header, an upper bound for legacy files
+
+		size_t chunk_size() const { return has_header ? header.chunk_size() : 0; }
+	};
+
+	// Identifies one load for single-flight purposes: the file version, the key and the
+	// placement options all have to match for callers to share a result.
+	struct LoadKey {
+		std::string path;
+		uint64_t device = 0;
+		uint64_t inode = 0;
+		uint64_t size = 0;
+		int64_t mtime_ns = 0;
+		uint64_t key_check = 0;
+		int policy = 0;
+		bool prefault = false;
+		int numa_node = -1;
+
+		bool operator<(const LoadKey& other) const {
+			return std::tie(path, device, inode, size, mtime_ns, key_check, policy, prefault,
+							numa_node) < std::tie(other.path, other.device, other.inode, other.size,
+												  other.mtime_ns, other.key_check, other.policy,
+												  other.prefault, other.numa_node);
+		}
+	};
+	struct SharedLoad {
+		std::shared_ptr<const DecryptedModel> model;
+		ProtectorStatus status = ProtectorStatus::kOk;
+	};
+
+	static std::unique_lock<std::timed_mutex> LockForLoad(const std::string& input_file);
+	std::unique_ptr<tflite::FlatBufferModel> LoadToModelBuffer(const std::string& input_file,
+															   SequentialFile& in,
+															   const EncryptedFileInfo& info);
+	bool MakeLoadKey(const std::string& model_path, LoadKey* key);
+	template <typename Vector>
+	bool DecryptToVector(const std::string& input_file, Vector& model_data);
+	template <typename Vector>
+	bool DecryptToVector(const std::string& input_file, SequentialFile& in,
+						 const EncryptedFileInfo& info, Vector& model_data);
+	bool DecryptToBuffer(const std::string& input_file, ModelBuffer& model_buffer, int numa_node,
+						 uint64_t* digest = nullptr);
+	bool DecryptToBuffer(const std::string& input_file, SequentialFile& in,
+						 const EncryptedFileInfo& info, ModelBuffer& model_buffer, int numa_node,
+						 uint64_t* digest = nullptr);
+	bool AdmitLoad(const std::string& input_file, size_t bytes,
+				   MemoryGovernor::Reservation* reservation);
+	bool OpenEncryptedFile(const std::string& path, SequentialFile& in, EncryptedFileInfo* info);
+	bool OpenEncryptedBuffer(const void* data, size_t size, SequentialFile& in,
+							 EncryptedFileInfo* info);
+	bool ValidateEncryptedInput(const std::string& path, SequentialFile& in,
+								EncryptedFileInfo* info);
+	static bool OpenChunkedFile(const std::string& path, SequentialFile& in, ModelHeader* header);
+	static bool OpenDelta(const std::string& path, SequentialFile& in, DeltaHeader* delta);
+	bool DecryptBody(SequentialFile& in, const EncryptedFileInfo& info, uint8_t* out,
+					 size_t* plain_size, uint64_t* digest = nullptr);
+	bool DecryptFinalBlock(const uint8_t* chaining_value, const uint8_t* last_cipher,
+						   uint8_t* plain, size_t* length);
+	static bool Fail(ProtectorStatus status, const std::string& message);
+	TaskExecutor& Executor();
+
 	uint8_t kEncryptionKey[kAesKeyLength] = {};
 	uint8_t kEncryptionIv[kAesIvLength] = {};
 
-	static std::mutex mutex_;
-	std::vector<char> model_buffer_;  // This is the decrypted model data in memory
+	BufferPolicy buffer_policy_ = BufferPolicy::kHeap;
+	bool prefault_buffer_ = false;
+	int numa_node_ = -1;  // -1 leaves placement to the kernel's first-touch policy
+	bool drop_page_cache_ = true;  // Evict ciphertext pages once decrypted
+	bool chunked_output_ = false;
+	ThreadPolicy worker_policy_;
+	std::shared_ptr<TaskExecutor> executor_;  // Null uses TaskExecutor::Default(worker_policy_)
+	std::shared_ptr<MemoryGovernor> memory_governor_;
+	bool deduplicate_models_ = true;
+
+	static constexpr std::chrono::milliseconds kLockPollInterval{10};
+
+	static std::timed_mutex mutex_;
+	static SingleFlight<LoadKey, SharedLoad> in_flight_loads_;
+	static thread_local ProtectorStatus last_status_;
+	ModelBuffer model_buffer_;	// Backs the model of the last successful LoadEncryptedModel()
 };
 
 #endif	// TFLITE_ENCRYPTOR_H_
\ No newline at end of file
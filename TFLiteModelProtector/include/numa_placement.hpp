@@ -0,0 +1,72 @@
+#ifndef TFLITE_NUMA_PLACEMENT_H_
+#define TFLITE_NUMA_PLACEMENT_H_
+
+#include <sched.h>
+#include <tensorflow/lite/model.h>
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "model_buffer.hpp"
+
+/**
+ * @brief Minimal NUMA topology queries, implemented on sysfs and raw syscalls so the library
+ * does not need libnuma at build or run time.
+ */
+class NumaTopology {
+   public:
+	static int NodeCount();
+	static std::vector<int> ReplicaNodes();
+	static int CurrentNode();
+	static bool CpusOfNode(int node, cpu_set_t* cpus);
+	static bool BindMemory(void* addr, size_t length, int node);
+};
+
+/**
+ * @brief Pins the calling thread to the CPUs of one node for the lifetime of the object, so that
+ * decryption runs, and first-touches memory, on that node. The previous affinity is restored.
+ */
+class ScopedNodeAffinity {
+   public:
+	explicit ScopedNodeAffinity(int node);
+	~ScopedNodeAffinity();
+
+	ScopedNodeAffinity(const ScopedNodeAffinity&) = delete;
+	ScopedNodeAffinity& operator=(const ScopedNodeAffinity&) = delete;
+
+	bool active() const { return active_; }
+
+   private:
+	cpu_set_t previous_;
+	bool active_ = false;
+};
+
+/**
+ * @brief One decrypted copy of a model per NUMA node.
+ *
+ * Inference threads call Local() to get the replica whose weights live on their own node.
+ * Threads on a node without a replica get the primary one, on the node it was decrypted on.
+ */
+class NumaReplicatedModel {
+   public:
+	NumaReplicatedModel() = default;
+	~NumaReplicatedModel();
+
+	NumaReplicatedModel(const NumaReplicatedModel&) = delete;
+	NumaReplicatedModel& operator=(const NumaReplicatedModel&) = delete;
+
+	const tflite::FlatBufferModel* Local() const;
+	const tflite::FlatBufferModel* ForNode(int node) const;
+	size_t replica_count() const;
+
+   private:
+	friend class TFLiteModelProtector;
+
+	std::vector<ModelBuffer> buffers_;	// Indexed by node; empty for nodes without a replica
+	std::vector<std::unique_ptr<tflite::FlatBufferModel>> models_;
+	int primary_node_ = 0;
+};
+
+#endif	// TFLITE_NUMA_PLACEMENT_H_
@@ -0,0 +1,74 @@
+#ifndef TFLITE_OPERATION_CONTROL_H_
+#define TFLITE_OPERATION_CONTROL_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include "model_format.hpp"
+
+/**
+ * @brief Lets one thread abandon an operation running on another.
+ *
+ * Copies share one flag: hand a copy to the operation and keep one to cancel it with.
+ */
+class CancellationToken {
+   public:
+	CancellationToken() : cancelled_(std::make_shared<std::atomic<bool>>(false)) {}
+
+	void Cancel() { cancelled_->store(true, std::memory_order_relaxed); }
+	bool cancelled() const { return cancelled_->load(std::memory_order_relaxed); }
+
+   private:
+	std::shared_ptr<std::atomic<bool>> cancelled_;
+};
+
+/**
+ * @brief Cancellation, deadline and progress reporting for the protector calls of one thread.
+ *
+ * Install it with ScopedOperationControl instead of passing it to every call. Loads, decryption,
+ * encryption and re-encryption poll it between kIoChunkSize steps and fail with kCancelled or
+ * kDeadlineExceeded, wiping any plaintext already produced; loads also poll it before they
+ * allocate, while the memory governor defers them and while they wait for the load lock.
+ */
+struct OperationControl {
+	using Clock = std::chrono::steady_clock;
+	// Bytes of the current file processed so far, out of `total`. Called on the working thread,
+	// possibly with the protector locked, so it must be quick and must not call the protector.
+	using ProgressCallback = std::function<void(uint64_t done, uint64_t total)>;
+
+	CancellationToken token;
+	Clock::time_point deadline = Clock::time_point::max();
+	ProgressCallback progress;
+
+	ProtectorStatus Status() const;
+
+	// Current() is the control installed on the calling thread, or nullptr. Poll() returns its
+	// Status(), kOk if there is none; given a position it reports progress first.
+	static const OperationControl* Current();
+	static ProtectorStatus Poll();
+	static ProtectorStatus Poll(uint64_t done, uint64_t total);
+};
+
+/**
+ * @brief Installs an OperationControl on the calling thread for the lifetime of the scope.
+ *
+ * Scopes nest; the previous control is restored on exit. The control must outlive the scope.
+ */
+class ScopedOperationControl {
+   public:
+	explicit ScopedOperationControl(const OperationControl& control)
+		: ScopedOperationControl(&control) {}
+	explicit ScopedOperationControl(const OperationControl* control);  // nullptr installs none
+	~ScopedOperationControl();
+
+	ScopedOperationControl(const ScopedOperationControl&) = delete;
+	ScopedOperationControl& operator=(const ScopedOperationControl&) = delete;
+
+   private:
+	const OperationControl* previous_;
+};
+
+#endif	// TFLITE_OPERATION_CONTROL_H_
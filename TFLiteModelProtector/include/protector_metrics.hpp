@@ -0,0 +1,112 @@
+#ifndef TFLITE_PROTECTOR_METRICS_H_
+#define TFLITE_PROTECTOR_METRICS_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "model_format.hpp"
+
+/**
+ * @brief Monotonic counter split into cache-line sized shards.
+ *
+ * Each thread increments the shard picked by its thread index with a relaxed atomic add, so hot
+ * paths on different cores never contend for the same line. Value() sums all shards.
+ */
+class ShardedCounter {
+   public:
+	static constexpr size_t kShards = 16;
+
+	void Add(uint64_t delta = 1);
+	uint64_t Value() const;
+
+	static size_t ThreadShard();
+
+   private:
+	struct alignas(64) Shard {
+		std::atomic<uint64_t> value{0};
+	};
+	std::array<Shard, kShards> shards_;
+};
+
+/**
+ * @brief Latency histogram with fixed buckets from 100 us to 10 s, sharded like ShardedCounter.
+ */
+class ShardedHistogram {
+   public:
+	static constexpr size_t kBuckets = 11;
+	static const std::array<double, kBuckets>& Bounds();  // Upper bounds in seconds
+
+	void Observe(std::chrono::nanoseconds duration);
+
+	// Cumulative bucket counts as Prometheus expects them, plus the total count and sum.
+	void Snapshot(std::array<uint64_t, kBuckets>* cumulative, uint64_t* count, double* sum) const;
+
+   private:
+	struct alignas(64) Shard {
+		std::array<std::atomic<uint64_t>, kBuckets + 1> buckets{};	// Last one is +Inf
+		std::atomic<uint64_t> sum_ns{0};
+	};
+	std::array<Shard, ShardedCounter::kShards> shards_;
+};
+
+enum class MetricsCache {
+	kLockedArena,	// Buffer blocks served from an already locked region
+	kSingleFlight,	// LoadSharedModel() calls that joined an in-flight load
+	kModelCache,	// ModelCache::Get() calls served from resident models
+	kContentDedup,	// Shared loads whose plaintext matched an already resident model
+};
+
+/**
+ * @brief Process-wide metrics for all protector instances, in Prometheus text format.
+ *
+ * Recording is lock-free. Render() produces the text exposition for a scrape handler; the
+ * exporter thread started by StartExporter() or StartFileExporter() pushes it periodically
+ * instead, which suits the node_exporter textfile collector.
+ */
+class ProtectorMetrics {
+   public:
+	using Sink = std::function<void(const std::string&)>;
+
+	static ProtectorMetrics& Instance();
+
+	void RecordLoad() { loads_.Add(); }
+	void RecordDecrypt(uint64_t bytes, std::chrono::nanoseconds duration);
+	void RecordFailure(ProtectorStatus status);
+	void RecordLockWait(std::chrono::nanoseconds duration) { lock_wait_.Observe(duration); }
+	void RecordCacheHit(MetricsCache cache);
+	void RecordCacheMiss(MetricsCache cache);
+
+	std::string Render() const;
+
+	void StartExporter(Sink sink, std::chrono::milliseconds interval);
+	void StartFileExporter(const std::string& path, std::chrono::milliseconds interval);
+	void StopExporter();
+
+   private:
+	static constexpr size_t kCacheKinds = 4;
+
+	ProtectorMetrics() = default;
+
+	ShardedCounter loads_;
+	ShardedCounter bytes_decrypted_;
+	ShardedHistogram decrypt_latency_;
+	ShardedHistogram lock_wait_;
+	std::array<ShardedCounter, kCacheKinds> cache_hits_;
+	std::array<ShardedCounter, kCacheKinds> cache_misses_;
+	std::array<ShardedCounter, kProtectorStatusCount> failures_;
+
+	std::mutex exporter_mutex_;
+	std::condition_variable exporter_wakeup_;
+	std::thread exporter_;
+	bool exporter_stop_ = false;
+};
+
+#endif	// TFLITE_PROTECTOR_METRICS_H_
@@ -0,0 +1,47 @@
+#ifndef TFLITE_SEQUENTIAL_FILE_H_
+#define TFLITE_SEQUENTIAL_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief Read-only file descriptor wrapper for reading ciphertext front to back.
+ *
+ * Open() advises the kernel of sequential access, which enlarges readahead for this descriptor.
+ * DropConsumed() tells the kernel that everything read so far can leave the page cache, so a
+ * decrypted model does not also keep its ciphertext resident.
+ *
+ * OpenMemory() reads from a caller's buffer instead, so ciphertext received over IPC or linked
+ * into the binary goes through the same validation and decryption as a file. Next() then hands
+ * out pointers into that buffer rather than copying.
+ */
+class SequentialFile {
+   public:
+	SequentialFile() = default;
+	~SequentialFile();
+
+	SequentialFile(const SequentialFile&) = delete;
+	SequentialFile& operator=(const SequentialFile&) = delete;
+
+	bool Open(const std::string& path);
+	void OpenMemory(const void* data, size_t size);
+	void Close();
+
+	bool Read(void* out, size_t length);
+	const uint8_t* Next(uint8_t* scratch, size_t length);
+	bool Seek(size_t offset);
+	void DropConsumed();
+
+	bool is_open() const { return fd_ >= 0 || memory_ != nullptr; }
+	size_t size() const { return size_; }
+	size_t offset() const { return offset_; }
+
+   private:
+	int fd_ = -1;
+	const uint8_t* memory_ = nullptr;
+	size_t size_ = 0;
+	size_t offset_ = 0;
+};
+
+#endif	// TFLITE_SEQUENTIAL_FILE_H_
@@ -0,0 +1,93 @@
+#ifndef TFLITE_SINGLE_FLIGHT_H_
+#define TFLITE_SINGLE_FLIGHT_H_
+
+#include <chrono>
+#include <future>
+#include <map>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+
+/**
+ * @brief Collapses concurrent calls with the same key into one execution.
+ *
+ * The first caller for a key (the leader) runs the function; callers arriving while it runs wait
+ * for it and receive a copy of the same result. Once the call completes the key is forgotten, so
+ * this deduplicates only in-flight work and is not a cache. Exceptions thrown by the function are
+ * rethrown to every waiter.
+ */
+template <typename Key, typename Value>
+class SingleFlight {
+   public:
+	/**
+	 * @param key Identifies the work.
+	 * @param fn Produces the value; called at most once per set of overlapping calls.
+	 * @param joined Set to true if this call waited for another caller's result.
+	 */
+	template <typename Fn>
+	Value Do(const Key& key, Fn&& fn, bool* joined = nullptr) {
+		return Do(key, std::forward<Fn>(fn), joined, nullptr);
+	}
+
+	/**
+	 * @brief Like Do() above, but a joined caller polls `give_up` every kGiveUpInterval while it
+	 * waits, and returns a default-constructed Value as soon as it returns true. The leader always
+	 * runs to completion.
+	 */
+	template <typename Fn, typename GiveUp>
+	Value Do(const Key& key, Fn&& fn, bool* joined, GiveUp&& give_up) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		auto it = calls_.find(key);
+		if (it != calls_.end()) {
+			std::shared_future<Value> result = it->second;
+			lock.unlock();
+			if (joined != nullptr) {
+				*joined = true;
+			}
+			if constexpr (!std::is_same_v<std::decay_t<GiveUp>, std::nullptr_t>) {
+				while (result.wait_for(kGiveUpInterval) != std::future_status::ready) {
+					if (give_up()) {
+						return Value();
+					}
+				}
+			}
+			return result.get();
+		}
+
+		std::promise<Value> promise;
+		calls_.emplace(key, promise.get_future().share());
+		lock.unlock();
+		if (joined != nullptr) {
+			*joined = false;
+		}
+
+		try {
+			Value value = std::forward<Fn>(fn)();
+			promise.set_value(value);
+			Forget(key);
+			return value;
+		} catch (...) {
+			promise.set_exception(std::current_exception());
+			Forget(key);
+			throw;
+		}
+	}
+
+	size_t in_flight() const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return calls_.size();
+	}
+
+   private:
+	static constexpr std::chrono::milliseconds kGiveUpInterval{10};
+
+	void Forget(const Key& key) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		calls_.erase(key);
+	}
+
+	mutable std::mutex mutex_;
+	std::map<Key, std::shared_future<Value>> calls_;
+};
+
+#endif	// TFLITE_SINGLE_FLIGHT_H_
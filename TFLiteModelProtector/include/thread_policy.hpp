@@ -0,0 +1,35 @@
+#ifndef TFLITE_THREAD_POLICY_H_
+#define TFLITE_THREAD_POLICY_H_
+
+#include <vector>
+
+/**
+ * @brief CPU set, scheduling class and I/O priority for the library's own worker threads.
+ *
+ * Applied once when a worker starts, and never to a caller's thread: lowering a thread's
+ * priority is always allowed, but raising it back usually needs CAP_SYS_NICE. A default
+ * constructed policy changes nothing, so workers inherit the settings of the thread that
+ * created them.
+ */
+struct ThreadPolicy {
+	enum class IoClass {
+		kInherit,
+		kBestEffort,  // Normal disk scheduling at io_level, 0 (highest) to 7 (lowest)
+		kIdle,		  // Disk access only when no other process wants the disk
+	};
+
+	std::vector<int> cpus;	// Empty keeps the inherited affinity
+	bool idle = false;		// SCHED_IDLE: run only on CPUs with nothing else runnable
+	int nice = 0;			// Added to the inherited nice value; ignored under SCHED_IDLE
+	IoClass io_class = IoClass::kInherit;
+	int io_level = 7;
+
+	// SCHED_IDLE and the idle I/O class: work that must never delay inference.
+	static ThreadPolicy Background();
+
+	bool is_default() const;
+	bool operator==(const ThreadPolicy& other) const;
+	bool ApplyToCurrentThread() const;
+};
+
+#endif	// TFLITE_THREAD_POLICY_H_
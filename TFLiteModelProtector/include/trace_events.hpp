@@ -0,0 +1,82 @@
+#ifndef TFLITE_TRACE_EVENTS_H_
+#define TFLITE_TRACE_EVENTS_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Collects spans in the Chrome trace-event format, viewable in Perfetto UI or
+ * chrome://tracing.
+ *
+ * Tracing is off by default; while it is off a ScopedTrace costs one relaxed atomic load. Each
+ * thread records into its own buffer, so concurrent loads do not serialize on the recorder.
+ * Spans on one thread nest by time, so the model path only needs to be attached to the outermost
+ * span of a load.
+ */
+class TraceRecorder {
+   public:
+	static TraceRecorder& Instance();
+
+	void Start();
+	void Stop();
+	bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+	// Writes everything recorded since Start() as {"traceEvents": [...]} and clears the buffers.
+	bool WriteJson(const std::string& path);
+
+	void Record(const char* name, const std::string& model,
+				std::chrono::steady_clock::time_point start,
+				std::chrono::steady_clock::time_point end);
+
+   private:
+	struct Event {
+		const char* name;
+		std::string model;
+		int64_t start_ns;
+		int64_t duration_ns;
+	};
+	struct ThreadBuffer {
+		int tid = 0;
+		std::mutex mutex;  // Only contended while WriteJson() drains the buffer
+		std::vector<Event> events;
+		bool exited = false;  // Set when the thread ends; WriteJson() then drops the buffer
+	};
+
+	TraceRecorder() = default;
+	ThreadBuffer& LocalBuffer();
+
+	std::atomic<bool> enabled_{false};
+	std::chrono::steady_clock::time_point origin_ = std::chrono::steady_clock::now();
+	std::mutex buffers_mutex_;
+	std::vector<std::shared_ptr<ThreadBuffer>> buffers_;
+};
+
+/**
+ * @brief Records a span from construction to destruction while tracing is enabled.
+ *
+ * `name` must outlive the recorder, which in practice means a string literal.
+ */
+class ScopedTrace {
+   public:
+	explicit ScopedTrace(const char* name) : ScopedTrace(name, nullptr) {}
+	ScopedTrace(const char* name, const std::string& model) : ScopedTrace(name, &model) {}
+	~ScopedTrace();
+
+	ScopedTrace(const ScopedTrace&) = delete;
+	ScopedTrace& operator=(const ScopedTrace&) = delete;
+
+   private:
+	ScopedTrace(const char* name, const std::string* model);
+
+	const char* name_;
+	const std::string* model_;
+	bool active_;
+	std::chrono::steady_clock::time_point start_;
+};
+
+#endif	// TFLITE_TRACE_EVENTS_H_
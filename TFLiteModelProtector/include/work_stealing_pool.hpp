@@ -0,0 +1,124 @@
+#ifndef TFLITE_WORK_STEALING_POOL_H_
+#define TFLITE_WORK_STEALING_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "thread_policy.hpp"
+
+/**
+ * @brief Runs the library's parallel work.
+ *
+ * Implement it to run that work on the host application's own pool, and install it with
+ * SetDefault() or TFLiteModelProtector::SetExecutor(), so the process has one set of threads.
+ */
+class TaskExecutor {
+   public:
+	using Task = std::function<void()>;
+
+	virtual ~TaskExecutor() = default;
+
+	// Queues `task`. Tasks must not throw; TaskGroup catches on their behalf.
+	virtual void Submit(Task task) = 0;
+	// How many tasks can usefully run at once.
+	virtual size_t concurrency() const = 0;
+	// Runs one queued task on the calling thread if there is one the caller may run. A thread
+	// waiting in TaskGroup::Wait() calls this, which is what makes nested fork/join safe.
+	virtual bool RunPendingTask() { return false; }
+
+	static void SetDefault(std::shared_ptr<TaskExecutor> executor);
+	static TaskExecutor& Default(const ThreadPolicy& policy = ThreadPolicy());
+};
+
+/**
+ * @brief Work-stealing thread pool, shared by everything the library runs in parallel.
+ *
+ * Each worker owns a deque: tasks it submits go to the back and it takes them from the back, so
+ * nested work stays hot in its cache; idle workers steal from the front of the others' deques.
+ * Tasks from other threads go to a shared injection queue. Workers apply the pool's ThreadPolicy
+ * once when they start.
+ *
+ * Shared() keeps one pool per distinct policy, sized by EffectiveCpuCount() unless SetSharedSize()
+ * says otherwise, so forty concurrent loads on a 32-core host queue up instead of starting forty
+ * threads.
+ */
+class WorkStealingPool : public TaskExecutor {
+   public:
+	explicit WorkStealingPool(size_t threads = 0, const ThreadPolicy& policy = ThreadPolicy());
+	~WorkStealingPool() override;
+
+	WorkStealingPool(const WorkStealingPool&) = delete;
+	WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+	void Submit(Task task) override;
+	size_t concurrency() const override { return workers_.size(); }
+	bool RunPendingTask() override;
+
+	static WorkStealingPool& Shared(const ThreadPolicy& policy = ThreadPolicy());
+	static void SetSharedSize(size_t threads);
+
+   private:
+	struct alignas(64) Worker {
+		std::mutex mutex;
+		std::deque<Task> tasks;
+		std::thread thread;
+	};
+
+	void WorkerLoop(size_t index);
+	bool TakeTask(size_t index, Task* task);
+	bool PopInjected(Task* task);
+	void Run(Task& task);
+	void Wake();
+
+	const ThreadPolicy policy_;
+	const bool outside_helpers_;  // Whether non-worker threads may run this pool's tasks
+	std::vector<std::unique_ptr<Worker>> workers_;
+	std::mutex injection_mutex_;
+	std::deque<Task> injected_;
+	std::atomic<size_t> queued_{0};
+
+	std::mutex sleep_mutex_;
+	std::condition_variable wakeup_;
+	size_t sleepers_ = 0;
+	bool stop_ = false;
+};
+
+/**
+ * @brief Fork/join scope: Run() forks tasks on an executor and Wait() joins them.
+ *
+ * A thread in Wait() runs pending tasks rather than blocking, so a task may itself open a
+ * TaskGroup and wait without starving the pool. The first exception a task throws is rethrown
+ * by Wait(). The destructor waits too, but swallows exceptions.
+ */
+class TaskGroup {
+   public:
+	explicit TaskGroup(TaskExecutor& executor) : executor_(executor) {}
+	~TaskGroup();
+
+	TaskGroup(const TaskGroup&) = delete;
+	TaskGroup& operator=(const TaskGroup&) = delete;
+
+	void Run(std::function<void()> task);
+	void Wait();
+
+   private:
+	struct State {
+		std::mutex mutex;
+		std::condition_variable done;
+		size_t pending = 0;
+		std::exception_ptr error;
+	};
+
+	TaskExecutor& executor_;
+	std::shared_ptr<State> state_ = std::make_shared<State>();
+};
+
+#endif	// TFLITE_WORK_STEALING_POOL_H_
@@ -0,0 +1,439 @@
+#include "aes_cbc.hpp"
+
+#include <openssl/crypto.h>
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TFLITE_PROTECTOR_X86 1
+#endif
+
+namespace {
+
+constexpr uint8_t kChunkIvTweak[16] = {'T', 'F', 'L', 'i', 't', 'e', 'C', 'h',
+									   'u', 'n', 'k', 'e', 'd', 'I', 'V', '!'};
+
+#ifdef TFLITE_PROTECTOR_X86
+
+using RoundKeys = __m128i[AesCbcDecryptor::kRounds + 1];
+
+__attribute__((target("aes,sse2"))) __m128i ExpandEven(__m128i key, __m128i assist) {
+	assist = _mm_shuffle_epi32(assist, 0xff);
+	key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+	key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+	key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+	return _mm_xor_si128(key, assist);
+}
+
+__attribute__((target("aes,sse2"))) __m128i ExpandOdd(__m128i key, __m128i assist) {
+	assist = _mm_shuffle_epi32(assist, 0xaa);
+	key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+	key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+	key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+	return _mm_xor_si128(key, assist);
+}
+
+/**
+ * @brief Builds the AES-256 decryption schedule (equivalent inverse cipher) with AES-NI.
+ */
+__attribute__((target("aes,sse2"))) void ExpandDecryptionKey(const uint8_t* key,
+															 uint8_t* schedule) {
+	__m128i ek[AesCbcDecryptor::kRounds + 1];
+	ek[0] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(key));
+	ek[1] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(key + 16));
+	// _mm_aeskeygenassist_si128 needs an immediate round constant, hence no loop.
+	ek[2] = ExpandEven(ek[0], _mm_aeskeygenassist_si128(ek[1], 0x01));
+	ek[3] = ExpandOdd(ek[1], _mm_aeskeygenassist_si128(ek[2], 0x00));
+	ek[4] = ExpandEven(ek[2], _mm_aeskeygenassist_si128(ek[3], 0x02));
+	ek[5] = ExpandOdd(ek[3], _mm_aeskeygenassist_si128(ek[4], 0x00));
+	ek[6] = ExpandEven(ek[4], _mm_aeskeygenassist_si128(ek[5], 0x04));
+	ek[7] = ExpandOdd(ek[5], _mm_aeskeygenassist_si128(ek[6], 0x00));
+	ek[8] = ExpandEven(ek[6], _mm_aeskeygenassist_si128(ek[7], 0x08));
+	ek[9] = ExpandOdd(ek[7], _mm_aeskeygenassist_si128(ek[8], 0x00));
+	ek[10] = ExpandEven(ek[8], _mm_aeskeygenassist_si128(ek[9], 0x10));
+	ek[11] = ExpandOdd(ek[9], _mm_aeskeygenassist_si128(ek[10], 0x00));
+	ek[12] = ExpandEven(ek[10], _mm_aeskeygenassist_si128(ek[11], 0x20));
+	ek[13] = ExpandOdd(ek[11], _mm_aeskeygenassist_si128(ek[12], 0x00));
+	ek[14] = ExpandEven(ek[12], _mm_aeskeygenassist_si128(ek[13], 0x40));
+
+	auto* out = reinterpret_cast<__m128i*>(schedule);
+	_mm_storeu_si128(out, ek[AesCbcDecryptor::kRounds]);
+	for (int r = 1; r < AesCbcDecryptor::kRounds; ++r) {
+		_mm_storeu_si128(out + r, _mm_aesimc_si128(ek[AesCbcDecryptor::kRounds - r]));
+	}
+	_mm_storeu_si128(out + AesCbcDecryptor::kRounds, ek[0]);
+	OPENSSL_cleanse(ek, sizeof(ek));
+}
+
+__attribute__((target("aes,sse2"))) void CbcDecryptAesNi(const uint8_t* schedule,
+														 const uint8_t* in, uint8_t* out,
+														 size_t blocks, uint8_t* iv) {
+	constexpr size_t kLanes = 8;  // Enough independent blocks to cover the aesdec latency
+	RoundKeys k;
+	for (int r = 0; r <= AesCbcDecryptor::kRounds; ++r) {
+		k[r] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(schedule) + r);
+	}
+	const auto* src = reinterpret_cast<const __m128i*>(in);
+	auto* dst = reinterpret_cast<__m128i*>(out);
+	__m128i prev = _mm_loadu_si128(reinterpret_cast<const __m128i*>(iv));
+
+	size_t i = 0;
+	for (; i + kLanes <= blocks; i += kLanes) {
+		__m128i c[kLanes];
+		__m128i x[kLanes];
+		for (size_t j = 0; j < kLanes; ++j) {
+			c[j] = _mm_loadu_si128(src + i + j);
+			x[j] = _mm_xor_si128(c[j], k[0]);
+		}
+		for (int r = 1; r < AesCbcDecryptor::kRounds; ++r) {
+			for (size_t j = 0; j < kLanes; ++j) {
+				x[j] = _mm_aesdec_si128(x[j], k[r]);
+			}
+		}
+		for (size_t j = 0; j < kLanes; ++j) {
+			x[j] = _mm_aesdeclast_si128(x[j], k[AesCbcDecryptor::kRounds]);
+		}
+		_mm_storeu_si128(dst + i, _mm_xor_si128(x[0], prev));
+		for (size_t j = 1; j < kLanes; ++j) {
+			_mm_storeu_si128(dst + i + j, _mm_xor_si128(x[j], c[j - 1]));
+		}
+		prev = c[kLanes - 1];
+	}
+	for (; i < blocks; ++i) {
+		const __m128i c = _mm_loadu_si128(src + i);
+		__m128i x = _mm_xor_si128(c, k[0]);
+		for (int r = 1; r < AesCbcDecryptor::kRounds; ++r) {
+			x = _mm_aesdec_si128(x, k[r]);
+		}
+		x = _mm_aesdeclast_si128(x, k[AesCbcDecryptor::kRounds]);
+		_mm_storeu_si128(dst + i, _mm_xor_si128(x, prev));
+		prev = c;
+	}
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(iv), prev);
+}
+
+__attribute__((target("vaes,avx2,aes"))) void CbcDecryptVaes256(const uint8_t* schedule,
+																const uint8_t* in, uint8_t* out,
+																size_t blocks, uint8_t* iv) {
+	__m256i k[AesCbcDecryptor::kRounds + 1];
+	for (int r = 0; r <= AesCbcDecryptor::kRounds; ++r) {
+		k[r] = _mm256_broadcastsi128_si256(
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(schedule) + r));
+	}
+	__m128i prev = _mm_loadu_si128(reinterpret_cast<const __m128i*>(iv));
+
+	size_t i = 0;
+	for (; i + 8 <= blocks; i += 8) {
+		const auto* src = reinterpret_cast<const __m256i*>(in + i * AesCbcDecryptor::kBlockSize);
+		auto* dst = reinterpret_cast<__m256i*>(out + i * AesCbcDecryptor::kBlockSize);
+		const __m256i c0 = _mm256_loadu_si256(src);
+		const __m256i c1 = _mm256_loadu_si256(src + 1);
+		const __m256i c2 = _mm256_loadu_si256(src + 2);
+		const __m256i c3 = _mm256_loadu_si256(src + 3);
+		__m256i x0 = _mm256_xor_si256(c0, k[0]);
+		__m256i x1 = _mm256_xor_si256(c1, k[0]);
+		__m256i x2 = _mm256_xor_si256(c2, k[0]);
+		__m256i x3 = _mm256_xor_si256(c3, k[0]);
+		for (int r = 1; r < AesCbcDecryptor::kRounds; ++r) {
+			x0 = _mm256_aesdec_epi128(x0, k[r]);
+			x1 = _mm256_aesdec_epi128(x1, k[r]);
+			x2 = _mm256_aesdec_epi128(x2, k[r]);
+			x3 = _mm256_aesdec_epi128(x3, k[r]);
+		}
+		x0 = _mm256_aesdeclast_epi128(x0, k[AesCbcDecryptor::kRounds]);
+		x1 = _mm256_aesdeclast_epi128(x1, k[AesCbcDecryptor::kRounds]);
+		x2 = _mm256_aesdeclast_epi128(x2, k[AesCbcDecryptor::kRounds]);
+		x3 = _mm256_aesdeclast_epi128(x3, k[AesCbcDecryptor::kRounds]);
+		// Each block is chained with the ciphertext one block earlier, i.e. shifted by one lane.
+		const __m256i p0 = _mm256_inserti128_si256(_mm256_castsi128_si256(prev),
+												   _mm256_castsi256_si128(c0), 1);
+		const __m256i p1 = _mm256_permute2x128_si256(c0, c1, 0x21);
+		const __m256i p2 = _mm256_permute2x128_si256(c1, c2, 0x21);
+		const __m256i p3 = _mm256_permute2x128_si256(c2, c3, 0x21);
+		prev = _mm256_extracti128_si256(c3, 1);
+		_mm256_storeu_si256(dst, _mm256_xor_si256(x0, p0));
+		_mm256_storeu_si256(dst + 1, _mm256_xor_si256(x1, p1));
+		_mm256_storeu_si256(dst + 2, _mm256_xor_si256(x2, p2));
+		_mm256_storeu_si256(dst + 3, _mm256_xor_si256(x3, p3));
+	}
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(iv), prev);
+	const size_t done = i * AesCbcDecryptor::kBlockSize;
+	CbcDecryptAesNi(schedule, in + done, out + done, blocks - i, iv);
+}
+
+// GCC's unmasked avx512 intrinsics merge into _mm512_undefined_*() and warn about it; the
+// zero-masking forms with every lane selected compile to the same instructions without that.
+constexpr __mmask8 kAllQwords = 0xff;
+constexpr __mmask8 kAllDwords128 = 0x0f;
+constexpr __mmask16 kAllLanes = 0xffff;
+
+__attribute__((target("vaes,avx512f,aes"))) void CbcDecryptVaes512(const uint8_t* schedule,
+																   const uint8_t* in,
+																   uint8_t* out, size_t blocks,
+																   uint8_t* iv) {
+	__m512i k[AesCbcDecryptor::kRounds + 1];
+	for (int r = 0; r <= AesCbcDecryptor::kRounds; ++r) {
+		k[r] = _mm512_maskz_broadcast_i32x4(
+			kAllLanes, _mm_loadu_si128(reinterpret_cast<const __m128i*>(schedule) + r));
+	}
+	// Only the top lane of `prev` is ever used: it holds the last ciphertext block seen.
+	__m512i prev = _mm512_maskz_broadcast_i32x4(
+		kAllLanes, _mm_loadu_si128(reinterpret_cast<const __m128i*>(iv)));
+
+	size_t i = 0;
+	for (; i + 16 <= blocks; i += 16) {
+		const uint8_t* src = in + i * AesCbcDecryptor::kBlockSize;
+		uint8_t* dst = out + i * AesCbcDecryptor::kBlockSize;
+		const __m512i c0 = _mm512_loadu_si512(src);
+		const __m512i c1 = _mm512_loadu_si512(src + 64);
+		const __m512i c2 = _mm512_loadu_si512(src + 128);
+		const __m512i c3 = _mm512_loadu_si512(src + 192);
+		__m512i x0 = _mm512_xor_si512(c0, k[0]);
+		__m512i x1 = _mm512_xor_si512(c1, k[0]);
+		__m512i x2 = _mm512_xor_si512(c2, k[0]);
+		__m512i x3 = _mm512_xor_si512(c3, k[0]);
+		for (int r = 1; r < AesCbcDecryptor::kRounds; ++r) {
+			x0 = _mm512_aesdec_epi128(x0, k[r]);
+			x1 = _mm512_aesdec_epi128(x1, k[r]);
+			x2 = _mm512_aesdec_epi128(x2, k[r]);
+			x3 = _mm512_aesdec_epi128(x3, k[r]);
+		}
+		x0 = _mm512_aesdeclast_epi128(x0, k[AesCbcDecryptor::kRounds]);
+		x1 = _mm512_aesdeclast_epi128(x1, k[AesCbcDecryptor::kRounds]);
+		x2 = _mm512_aesdeclast_epi128(x2, k[AesCbcDecryptor::kRounds]);
+		x3 = _mm512_aesdeclast_epi128(x3, k[AesCbcDecryptor::kRounds]);
+		// alignr by six qwords yields [b.block3, a.block0, a.block1, a.block2].
+		const __m512i p0 = _mm512_maskz_alignr_epi64(kAllQwords, c0, prev, 6);
+		const __m512i p1 = _mm512_maskz_alignr_epi64(kAllQwords, c1, c0, 6);
+		const __m512i p2 = _mm512_maskz_alignr_epi64(kAllQwords, c2, c1, 6);
+		const __m512i p3 = _mm512_maskz_alignr_epi64(kAllQwords, c3, c2, 6);
+		prev = c3;
+		_mm512_storeu_si512(dst, _mm512_xor_si512(x0, p0));
+		_mm512_storeu_si512(dst + 64, _mm512_xor_si512(x1, p1));
+		_mm512_storeu_si512(dst + 128, _mm512_xor_si512(x2, p2));
+		_mm512_storeu_si512(dst + 192, _mm512_xor_si512(x3, p3));
+	}
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(iv),
+					 _mm512_maskz_extracti32x4_epi32(kAllDwords128, prev, 3));
+	const size_t done = i * AesCbcDecryptor::kBlockSize;
+	CbcDecryptAesNi(schedule, in + done, out + done, blocks - i, iv);
+}
+
+#endif	// TFLITE_PROTECTOR_X86
+
+}  // namespace
+
+#ifdef TFLITE_PROTECTOR_X86
+
+template <AesPath Path>
+void CbcDecryptKernel(const uint8_t* schedule, const uint8_t* in, uint8_t* out, size_t blocks,
+					  uint8_t* iv) {
+	static_assert(Path != AesPath::kPortable, "The portable path has no kernel");
+	if constexpr (Path == AesPath::kVaes512) {
+		CbcDecryptVaes512(schedule, in, out, blocks, iv);
+	} else if constexpr (Path == AesPath::kVaes256) {
+		CbcDecryptVaes256(schedule, in, out, blocks, iv);
+	} else {
+		CbcDecryptAesNi(schedule, in, out, blocks, iv);
+	}
+}
+
+template void CbcDecryptKernel<AesPath::kAesNi>(const uint8_t*, const uint8_t*, uint8_t*, size_t,
+												uint8_t*);
+template void CbcDecryptKernel<AesPath::kVaes256>(const uint8_t*, const uint8_t*, uint8_t*,
+												  size_t, uint8_t*);
+template void CbcDecryptKernel<AesPath::kVaes512>(const uint8_t*, const uint8_t*, uint8_t*,
+												  size_t, uint8_t*);
+
+#endif	// TFLITE_PROTECTOR_X86
+
+AesCbcDecryptor::AesCbcDecryptor(const uint8_t* key, const uint8_t* iv)
+	: AesCbcDecryptor(key, iv, CpuFeatures::Get().aes_path) {}
+
+/**
+ * @brief Prepares a decryptor for an explicit path. Paths the CPU lacks fall back to portable.
+ */
+AesCbcDecryptor::AesCbcDecryptor(const uint8_t* key, const uint8_t* iv, AesPath path)
+	: path_(path <= CpuFeatures::Get().aes_path ? path : AesPath::kPortable) {
+	std::memcpy(iv_, iv, kBlockSize);
+#ifdef TFLITE_PROTECTOR_X86
+	if (path_ != AesPath::kPortable) {
+		ExpandDecryptionKey(key, round_keys_);
+		return;
+	}
+#else
+	path_ = AesPath::kPortable;
+#endif
+	ctx_ = EVP_CIPHER_CTX_new();
+	EVP_DecryptInit_ex(ctx_, EVP_aes_256_cbc(), nullptr, key, iv);
+	EVP_CIPHER_CTX_set_padding(ctx_, 0);
+}
+
+AesCbcDecryptor::~AesCbcDecryptor() {
+	OPENSSL_cleanse(round_keys_, sizeof(round_keys_));
+	OPENSSL_cleanse(iv_, sizeof(iv_));
+	if (ctx_ != nullptr) {
+		EVP_CIPHER_CTX_free(ctx_);
+	}
+}
+
+/**
+ * @brief Decrypts `blocks` whole cipher blocks from `in` to `out`.
+ *
+ * @return false only if the portable EVP path reports an error.
+ */
+bool AesCbcDecryptor::DecryptBlocks(const uint8_t* in, uint8_t* out, size_t blocks) {
+	if (blocks == 0) {
+		return true;
+	}
+	switch (path_) {
+#ifdef TFLITE_PROTECTOR_X86
+		case AesPath::kVaes512:
+			return DecryptBlocksWith<AesPath::kVaes512>(in, out, blocks);
+		case AesPath::kVaes256:
+			return DecryptBlocksWith<AesPath::kVaes256>(in, out, blocks);
+		case AesPath::kAesNi:
+			return DecryptBlocksWith<AesPath::kAesNi>(in, out, blocks);
+#endif
+		default:
+			return DecryptBlocksPortable(in, out, blocks);
+	}
+}
+
+bool AesCbcDecryptor::DecryptBlocksPortable(const uint8_t* in, uint8_t* out, size_t blocks) {
+	if (blocks == 0) {
+		return true;
+	}
+	// Save the chaining value first: with in == out the ciphertext is about to be overwritten.
+	std::memcpy(iv_, in + (blocks - 1) * kBlockSize, kBlockSize);
+	int out_len = 0;
+	return EVP_DecryptUpdate(ctx_, out, &out_len, in, static_cast<int>(blocks * kBlockSize)) == 1;
+}
+
+/**
+ * @brief Replaces the chaining value, to start decrypting an independently chained segment.
+ */
+void AesCbcDecryptor::SetChainingValue(const uint8_t* iv) {
+	std::memcpy(iv_, iv, kBlockSize);
+	if (ctx_ != nullptr) {
+		EVP_DecryptInit_ex(ctx_, nullptr, nullptr, nullptr, iv);
+	}
+}
+
+ChunkIvDeriver::ChunkIvDeriver(const uint8_t* key, const uint8_t* iv) {
+	for (size_t i = 0; i < AesCbcDecryptor::kBlockSize; ++i) {
+		base_[i] = iv[i] ^ kChunkIvTweak[i];
+	}
+	ctx_ = EVP_CIPHER_CTX_new();
+	EVP_EncryptInit_ex(ctx_, EVP_aes_256_ecb(), nullptr, key, nullptr);
+	EVP_CIPHER_CTX_set_padding(ctx_, 0);
+}
+
+ChunkIvDeriver::~ChunkIvDeriver() {
+	OPENSSL_cleanse(base_, sizeof(base_));
+	EVP_CIPHER_CTX_free(ctx_);
+}
+
+bool ChunkIvDeriver::Derive(uint64_t index, uint8_t* chunk_iv) {
+	uint8_t block[AesCbcDecryptor::kBlockSize];
+	std::memcpy(block, base_, sizeof(block));
+	for (size_t i = 0; i < 8; ++i) {
+		block[8 + i] ^= static_cast<uint8_t>(index >> (8 * i));
+	}
+	int out_len = 0;
+	const bool ok = EVP_EncryptUpdate(ctx_, chunk_iv, &out_len, block, sizeof(block)) == 1;
+	OPENSSL_cleanse(block, sizeof(block));
+	return ok;
+}
+
+ChunkedCbcDecryptor::ChunkedCbcDecryptor(const uint8_t* key, const uint8_t* iv, size_t chunk_size)
+	: decryptor_(key, iv), ivs_(key, iv), chunk_blocks_(chunk_size / AesCbcDecryptor::kBlockSize) {
+	if (chunk_blocks_ != 0) {
+		ok_ = StartChunk(0);
+	}
+}
+
+bool ChunkedCbcDecryptor::StartChunk(uint64_t index) {
+	uint8_t chunk_iv[AesCbcDecryptor::kBlockSize];
+	if (!ivs_.Derive(index, chunk_iv)) {
+		return false;
+	}
+	decryptor_.SetChainingValue(chunk_iv);
+	chunk_index_ = index;
+	block_in_chunk_ = 0;
+	return true;
+}
+
+/**
+ * @brief Positions the decryptor at the first block of chunk `index`. Chunked layouts only.
+ */
+bool ChunkedCbcDecryptor::SeekToChunk(uint64_t index) {
+	ok_ = chunk_blocks_ != 0 && StartChunk(index);
+	return ok_;
+}
+
+bool ChunkedCbcDecryptor::DecryptBlocks(const uint8_t* in, uint8_t* out, size_t blocks) {
+	if (chunk_blocks_ == 0) {
+		return decryptor_.DecryptBlocks(in, out, blocks);
+	}
+	while (ok_ && blocks > 0) {
+		const size_t step = std::min(blocks, chunk_blocks_ - block_in_chunk_);
+		ok_ = decryptor_.DecryptBlocks(in, out, step);
+		in += step * AesCbcDecryptor::kBlockSize;
+		out += step * AesCbcDecryptor::kBlockSize;
+		blocks -= step;
+		block_in_chunk_ += step;
+		if (ok_ && block_in_chunk_ == chunk_blocks_) {
+			ok_ = StartChunk(chunk_index_ + 1);
+		}
+	}
+	return ok_;
+}
+
+ChunkedCbcEncryptor::ChunkedCbcEncryptor(const uint8_t* key, const uint8_t* iv, size_t chunk_size)
+	: ivs_(key, iv), chunk_size_(chunk_size) {
+	uint8_t first_iv[AesCbcDecryptor::kBlockSize];
+	std::memcpy(first_iv, iv, sizeof(first_iv));
+	if (chunk_size_ != 0) {
+		ok_ = ivs_.Derive(0, first_iv);
+	}
+	ctx_ = EVP_CIPHER_CTX_new();
+	ok_ = ok_ && EVP_EncryptInit_ex(ctx_, EVP_aes_256_cbc(), nullptr, key, first_iv) == 1;
+	OPENSSL_cleanse(first_iv, sizeof(first_iv));
+}
+
+ChunkedCbcEncryptor::~ChunkedCbcEncryptor() { EVP_CIPHER_CTX_free(ctx_); }
+
+/**
+ * @brief Encrypts `length` bytes. At each chunk boundary all input so far is a whole number of
+ * blocks, so nothing is buffered in the context when it is switched to the next chunk's IV.
+ */
+bool ChunkedCbcEncryptor::Update(const uint8_t* in, size_t length, uint8_t* out,
+								 size_t* out_length) {
+	*out_length = 0;
+	while (ok_ && length > 0) {
+		const size_t step =
+			chunk_size_ == 0 ? length : std::min(length, chunk_size_ - offset_in_chunk_);
+		int written = 0;
+		ok_ = EVP_EncryptUpdate(ctx_, out + *out_length, &written, in, static_cast<int>(step)) == 1;
+		*out_length += static_cast<size_t>(written);
+		in += step;
+		length -= step;
+		if (chunk_size_ != 0 && (offset_in_chunk_ += step) == chunk_size_) {
+			uint8_t chunk_iv[AesCbcDecryptor::kBlockSize];
+			ok_ = ok_ && ivs_.Derive(++chunk_index_, chunk_iv) &&
+				  EVP_EncryptInit_ex(ctx_, nullptr, nullptr, nullptr, chunk_iv) == 1;
+			offset_in_chunk_ = 0;
+		}
+	}
+	return ok_;
+}
+
+bool ChunkedCbcEncryptor::Final(uint8_t* out, size_t* out_length) {
+	int written = 0;
+	ok_ = ok_ && EVP_EncryptFinal_ex(ctx_, out, &written) == 1;
+	*out_length = static_cast<size_t>(written);
+	return ok_;
+}
@@ -0,0 +1,70 @@
+#include "cgroup.hpp"
+
+#include <sched.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <thread>
+
+namespace {
+
+constexpr const char* kCgroupRoot = "/sys/fs/cgroup";
+
+/**
+ * @brief Reads cpu.max ("<quota> <period>" or "max <period>") as a CPU count, rounded up.
+ *
+ * @return 0 if the file is missing or unlimited.
+ */
+size_t ReadCpuMax(const std::string& dir) {
+	std::ifstream in(dir + "/cpu.max");
+	std::string quota;
+	uint64_t period = 0;
+	if (!(in >> quota >> period) || quota == "max" || period == 0) {
+		return 0;
+	}
+	const uint64_t quota_us = std::stoull(quota);
+	return static_cast<size_t>(std::max<uint64_t>(1, (quota_us + period - 1) / period));
+}
+
+}  // namespace
+
+/**
+ * @brief Returns the cgroup v2 directory of this process, from the "0::" line of
+ * /proc/self/cgroup.
+ */
+std::string OwnCgroupDir() {
+	std::ifstream in("/proc/self/cgroup");
+	std::string line;
+	while (std::getline(in, line)) {
+		if (line.compare(0, 3, "0::") == 0) {
+			const std::string path = line.substr(3);
+			return path == "/" ? kCgroupRoot : kCgroupRoot + path;
+		}
+	}
+	return kCgroupRoot;
+}
+
+/**
+ * @brief Returns how many threads can run at once without being throttled.
+ *
+ * A container limited to 4 CPUs on a 64-core host still reports 64 hardware threads; sizing a
+ * pool by that makes the CFS quota throttle every thread for most of each period.
+ */
+size_t EffectiveCpuCount() {
+	size_t cpus = std::max(1u, std::thread::hardware_concurrency());
+	cpu_set_t set;
+	if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+		cpus = std::max(1, CPU_COUNT(&set));
+	}
+
+	const std::string root = kCgroupRoot;
+	for (std::string dir = OwnCgroupDir(); dir.size() > root.size();
+		 dir = dir.substr(0, dir.find_last_of('/'))) {
+		const size_t limit = ReadCpuMax(dir);
+		if (limit != 0) {
+			cpus = std::min(cpus, limit);
+		}
+	}
+	return cpus;
+}
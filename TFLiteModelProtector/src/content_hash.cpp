@@ -0,0 +1,352 @@
+#include "content_hash.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "cpu_features.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TFLITE_PROTECTOR_X86 1
+#endif
+
+namespace {
+
+constexpr uint64_t kPrime32_1 = 0x9E3779B1U;
+constexpr uint64_t kPrime32_2 = 0x85EBCA77U;
+constexpr uint64_t kPrime32_3 = 0xC2B2AE3DU;
+constexpr uint64_t kPrime64_1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t kPrime64_2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t kPrime64_3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t kPrime64_4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t kPrime64_5 = 0x27D4EB2F165667C5ULL;
+constexpr uint64_t kPrimeMx1 = 0x165667919E3779F9ULL;
+constexpr uint64_t kPrimeMx2 = 0x9FB21C651E98DF25ULL;
+
+constexpr size_t kSecretSize = 192;
+constexpr size_t kStripeLength = 64;
+constexpr size_t kSecretConsumeRate = 8;
+constexpr size_t kStripesPerBlock = (kSecretSize - kStripeLength) / kSecretConsumeRate;
+constexpr size_t kSecretLastAccStart = 7;
+constexpr size_t kSecretMergeAccsStart = 11;
+constexpr size_t kSecretSizeMin = 136;
+constexpr size_t kMidSizeStartOffset = 3;
+constexpr size_t kMidSizeLastOffset = 17;
+
+alignas(64) constexpr uint8_t kSecret[kSecretSize] = {
+	0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+	0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+	0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+	0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+	0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+	0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+	0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+	0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+	0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+	0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+	0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+	0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+// Little-endian loads; every supported target is little-endian.
+uint32_t Read32(const uint8_t* p) {
+	uint32_t value;
+	std::memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+uint64_t Read64(const uint8_t* p) {
+	uint64_t value;
+	std::memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+uint64_t Rotl64(uint64_t value, int bits) { return (value << bits) | (value >> (64 - bits)); }
+
+uint64_t Mul128Fold64(uint64_t lhs, uint64_t rhs) {
+	const unsigned __int128 product = static_cast<unsigned __int128>(lhs) * rhs;
+	return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+}
+
+uint64_t Xxh64Avalanche(uint64_t h) {
+	h ^= h >> 33;
+	h *= kPrime64_2;
+	h ^= h >> 29;
+	h *= kPrime64_3;
+	return h ^ (h >> 32);
+}
+
+uint64_t Avalanche(uint64_t h) {
+	h ^= h >> 37;
+	h *= kPrimeMx1;
+	return h ^ (h >> 32);
+}
+
+uint64_t Rrmxmx(uint64_t h, uint64_t length) {
+	h ^= Rotl64(h, 49) ^ Rotl64(h, 24);
+	h *= kPrimeMx2;
+	h ^= (h >> 35) + length;
+	h *= kPrimeMx2;
+	return h ^ (h >> 28);
+}
+
+uint64_t Mix16(const uint8_t* input, const uint8_t* secret) {
+	return Mul128Fold64(Read64(input) ^ Read64(secret), Read64(input + 8) ^ Read64(secret + 8));
+}
+
+uint64_t HashUpTo16(const uint8_t* input, size_t length) {
+	if (length > 8) {
+		const uint64_t lo = Read64(input) ^ (Read64(kSecret + 24) ^ Read64(kSecret + 32));
+		const uint64_t hi =
+			Read64(input + length - 8) ^ (Read64(kSecret + 40) ^ Read64(kSecret + 48));
+		return Avalanche(length + __builtin_bswap64(lo) + hi + Mul128Fold64(lo, hi));
+	}
+	if (length >= 4) {
+		const uint64_t combined =
+			Read32(input + length - 4) + (static_cast<uint64_t>(Read32(input)) << 32);
+		return Rrmxmx(combined ^ (Read64(kSecret + 8) ^ Read64(kSecret + 16)), length);
+	}
+	if (length > 0) {
+		const uint32_t combined = (static_cast<uint32_t>(input[0]) << 16) |
+								  (static_cast<uint32_t>(input[length >> 1]) << 24) |
+								  input[length - 1] | (static_cast<uint32_t>(length) << 8);
+		return Xxh64Avalanche(combined ^ (Read32(kSecret) ^ Read32(kSecret + 4)));
+	}
+	return Xxh64Avalanche(Read64(kSecret + 56) ^ Read64(kSecret + 64));
+}
+
+uint64_t Hash17To128(const uint8_t* input, size_t length) {
+	uint64_t acc = length * kPrime64_1;
+	if (length > 32) {
+		if (length > 64) {
+			if (length > 96) {
+				acc += Mix16(input + 48, kSecret + 96);
+				acc += Mix16(input + length - 64, kSecret + 112);
+			}
+			acc += Mix16(input + 32, kSecret + 64);
+			acc += Mix16(input + length - 48, kSecret + 80);
+		}
+		acc += Mix16(input + 16, kSecret + 32);
+		acc += Mix16(input + length - 32, kSecret + 48);
+	}
+	acc += Mix16(input, kSecret);
+	acc += Mix16(input + length - 16, kSecret + 16);
+	return Avalanche(acc);
+}
+
+uint64_t Hash129To240(const uint8_t* input, size_t length) {
+	uint64_t acc = length * kPrime64_1;
+	for (size_t i = 0; i < 8; ++i) {
+		acc += Mix16(input + 16 * i, kSecret + 16 * i);
+	}
+	uint64_t acc_end = Mix16(input + length - 16, kSecret + kSecretSizeMin - kMidSizeLastOffset);
+	acc = Avalanche(acc);
+	for (size_t i = 8; i < length / 16; ++i) {
+		acc_end += Mix16(input + 16 * i, kSecret + 16 * (i - 8) + kMidSizeStartOffset);
+	}
+	return Avalanche(acc + acc_end);
+}
+
+uint64_t HashShort(const uint8_t* input, size_t length) {
+	if (length <= 16) {
+		return HashUpTo16(input, length);
+	}
+	return length <= 128 ? Hash17To128(input, length) : Hash129To240(input, length);
+}
+
+void AccumulateStripeScalar(uint64_t* acc, const uint8_t* input, const uint8_t* secret) {
+	for (size_t i = 0; i < 8; ++i) {
+		const uint64_t data = Read64(input + 8 * i);
+		const uint64_t keyed = data ^ Read64(secret + 8 * i);
+		acc[i ^ 1] += data;
+		acc[i] += (keyed & 0xFFFFFFFFULL) * (keyed >> 32);
+	}
+}
+
+void ScrambleScalar(uint64_t* acc, const uint8_t* secret) {
+	for (size_t i = 0; i < 8; ++i) {
+		uint64_t value = acc[i];
+		value ^= value >> 47;
+		value ^= Read64(secret + 8 * i);
+		acc[i] = value * kPrime32_1;
+	}
+}
+
+#ifdef TFLITE_PROTECTOR_X86
+
+/**
+ * @brief Accumulates `stripes` consecutive stripes, then scrambles if `scramble` is set.
+ *
+ * Same arithmetic as the scalar loop: each 64-bit lane gains the 32x32 product of its keyed
+ * halves and the neighbouring lane gains the raw input.
+ */
+__attribute__((target("avx2"))) void AccumulateAvx2(uint64_t* acc, const uint8_t* input,
+													const uint8_t* secret, size_t stripes,
+													bool scramble) {
+	__m256i acc0 = _mm256_load_si256(reinterpret_cast<const __m256i*>(acc));
+	__m256i acc1 = _mm256_load_si256(reinterpret_cast<const __m256i*>(acc + 4));
+	for (size_t s = 0; s < stripes; ++s) {
+		const uint8_t* in = input + s * kStripeLength;
+		const uint8_t* key = secret + s * kSecretConsumeRate;
+		const __m256i data0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in));
+		const __m256i data1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + 32));
+		const __m256i keyed0 =
+			_mm256_xor_si256(data0, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(key)));
+		const __m256i keyed1 =
+			_mm256_xor_si256(data1, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(key + 32)));
+		const __m256i product0 = _mm256_mul_epu32(keyed0, _mm256_srli_epi64(keyed0, 32));
+		const __m256i product1 = _mm256_mul_epu32(keyed1, _mm256_srli_epi64(keyed1, 32));
+		const __m256i swapped0 = _mm256_shuffle_epi32(data0, 0x4E);
+		const __m256i swapped1 = _mm256_shuffle_epi32(data1, 0x4E);
+		acc0 = _mm256_add_epi64(acc0, _mm256_add_epi64(product0, swapped0));
+		acc1 = _mm256_add_epi64(acc1, _mm256_add_epi64(product1, swapped1));
+	}
+	if (scramble) {
+		const uint8_t* key = kSecret + kSecretSize - kStripeLength;
+		const __m256i prime = _mm256_set1_epi32(static_cast<int>(kPrime32_1));
+		const __m256i key0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(key));
+		const __m256i key1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(key + 32));
+		const __m256i mixed0 =
+			_mm256_xor_si256(_mm256_xor_si256(acc0, _mm256_srli_epi64(acc0, 47)), key0);
+		const __m256i mixed1 =
+			_mm256_xor_si256(_mm256_xor_si256(acc1, _mm256_srli_epi64(acc1, 47)), key1);
+		acc0 = _mm256_add_epi64(
+			_mm256_mul_epu32(mixed0, prime),
+			_mm256_slli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(mixed0, 32), prime), 32));
+		acc1 = _mm256_add_epi64(
+			_mm256_mul_epu32(mixed1, prime),
+			_mm256_slli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(mixed1, 32), prime), 32));
+	}
+	_mm256_store_si256(reinterpret_cast<__m256i*>(acc), acc0);
+	_mm256_store_si256(reinterpret_cast<__m256i*>(acc + 4), acc1);
+}
+
+#endif	// TFLITE_PROTECTOR_X86
+
+void Accumulate(uint64_t* acc, const uint8_t* input, const uint8_t* secret, size_t stripes,
+				bool scramble, bool use_avx2) {
+#ifdef TFLITE_PROTECTOR_X86
+	if (use_avx2) {
+		AccumulateAvx2(acc, input, secret, stripes, scramble);
+		return;
+	}
+#endif
+	for (size_t s = 0; s < stripes; ++s) {
+		AccumulateStripeScalar(acc, input + s * kStripeLength, secret + s * kSecretConsumeRate);
+	}
+	if (scramble) {
+		ScrambleScalar(acc, kSecret + kSecretSize - kStripeLength);
+	}
+}
+
+uint64_t MergeAccumulators(const uint64_t* acc, uint64_t length) {
+	uint64_t result = length * kPrime64_1;
+	for (size_t i = 0; i < 4; ++i) {
+		const uint8_t* secret = kSecret + kSecretMergeAccsStart + 16 * i;
+		result += Mul128Fold64(acc[2 * i] ^ Read64(secret), acc[2 * i + 1] ^ Read64(secret + 8));
+	}
+	return Avalanche(result);
+}
+
+}  // namespace
+
+Xxh3Hasher::Xxh3Hasher()
+	: acc_{kPrime32_3, kPrime64_1, kPrime64_2, kPrime64_3,
+		   kPrime64_4, kPrime32_2, kPrime64_5, kPrime32_1},
+	  use_avx2_(CpuFeatures::Get().avx2) {}
+
+/**
+ * @brief Hashes a complete buffer in one call.
+ */
+uint64_t Xxh3Hasher::Hash(const void* data, size_t length) {
+	if (length <= kMidSizeMax) {
+		return HashShort(static_cast<const uint8_t*>(data), length);
+	}
+	Xxh3Hasher hasher;
+	hasher.Update(data, length);
+	return hasher.Digest();
+}
+
+/**
+ * @brief Accumulates whole stripes, scrambling at every block boundary.
+ *
+ * Only stripes followed by at least one more input byte are passed in: the stripe that ends the
+ * input is hashed separately by Digest(), and no scramble follows the last block.
+ */
+void Xxh3Hasher::ConsumeStripes(uint64_t* acc, size_t* stripes_in_block, const uint8_t* input,
+								size_t stripes) const {
+	while (stripes > 0) {
+		const size_t batch = std::min(stripes, kStripesPerBlock - *stripes_in_block);
+		*stripes_in_block += batch;
+		const bool block_done = *stripes_in_block == kStripesPerBlock;
+		Accumulate(acc, input, kSecret + (*stripes_in_block - batch) * kSecretConsumeRate, batch,
+				   block_done, use_avx2_);
+		if (block_done) {
+			*stripes_in_block = 0;
+		}
+		input += batch * kStripeLength;
+		stripes -= batch;
+	}
+}
+
+/**
+ * @brief Adds `length` bytes to the digest.
+ *
+ * Large updates are accumulated straight from `data`; only the trailing partial stripe (and
+ * inputs that may still turn out to be short) are copied into the internal buffer.
+ */
+void Xxh3Hasher::Update(const void* data, size_t length) {
+	const uint8_t* input = static_cast<const uint8_t*>(data);
+	total_length_ += length;
+
+	if (buffered_ > 0 || total_length_ <= kMidSizeMax) {
+		const size_t take = std::min(length, kBufferSize - buffered_);
+		std::memcpy(buffer_ + buffered_, input, take);
+		buffered_ += take;
+		input += take;
+		length -= take;
+		if (length == 0) {
+			return;
+		}
+		// The buffer is full and more input follows, so all four stripes can be consumed.
+		ConsumeStripes(acc_, &stripes_in_block_, buffer_, kBufferSize / kStripeLength);
+		std::memcpy(last_stripe_, buffer_ + kBufferSize - kStripeLength, kStripeLength);
+		buffered_ = 0;
+	}
+
+	const size_t stripes = (length - 1) / kStripeLength;
+	if (stripes > 0) {
+		ConsumeStripes(acc_, &stripes_in_block_, input, stripes);
+		std::memcpy(last_stripe_, input + (stripes - 1) * kStripeLength, kStripeLength);
+		input += stripes * kStripeLength;
+		length -= stripes * kStripeLength;
+	}
+	std::memcpy(buffer_, input, length);
+	buffered_ = length;
+}
+
+/**
+ * @brief Returns the digest of everything passed to Update() so far. The hasher is not modified.
+ */
+uint64_t Xxh3Hasher::Digest() const {
+	if (total_length_ <= kMidSizeMax) {
+		return HashShort(buffer_, static_cast<size_t>(total_length_));
+	}
+
+	alignas(32) uint64_t acc[8];
+	std::memcpy(acc, acc_, sizeof(acc));
+	size_t stripes_in_block = stripes_in_block_;
+	ConsumeStripes(acc, &stripes_in_block, buffer_, (buffered_ - 1) / kStripeLength);
+
+	uint8_t last[kStripeLength];
+	const uint8_t* last_stripe = buffer_ + buffered_ - kStripeLength;
+	if (buffered_ < kStripeLength) {
+		const size_t carried = kStripeLength - buffered_;
+		std::memcpy(last, last_stripe_ + kStripeLength - carried, carried);
+		std::memcpy(last + carried, buffer_, buffered_);
+		last_stripe = last;
+	}
+	AccumulateStripeScalar(acc, last_stripe,
+						   kSecret + kSecretSize - kStripeLength - kSecretLastAccStart);
+	return MergeAccumulators(acc, total_length_);
+}
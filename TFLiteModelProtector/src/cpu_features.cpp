@@ -0,0 +1,60 @@
+#include "cpu_features.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+
+namespace {
+
+CpuFeatures Detect() {
+	CpuFeatures features;
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	features.aes = __builtin_cpu_supports("aes");
+	features.avx2 = __builtin_cpu_supports("avx2");
+	features.avx512f = __builtin_cpu_supports("avx512f");
+	features.vaes = __builtin_cpu_supports("vaes");
+#endif
+
+	if (features.aes && features.vaes && features.avx512f) {
+		features.aes_path = AesPath::kVaes512;
+	} else if (features.aes && features.vaes && features.avx2) {
+		features.aes_path = AesPath::kVaes256;
+	} else if (features.aes) {
+		features.aes_path = AesPath::kAesNi;
+	}
+
+	const char* requested = std::getenv("TFLITE_PROTECTOR_AES_PATH");
+	if (requested != nullptr) {
+		for (AesPath path : {AesPath::kPortable, AesPath::kAesNi, AesPath::kVaes256}) {
+			if (std::strcmp(requested, AesPathName(path)) == 0 && path < features.aes_path) {
+				features.aes_path = path;
+			}
+		}
+	}
+	return features;
+}
+
+// Forces detection while the library is being loaded rather than on the first decrypt.
+const CpuFeatures& kDetectedAtInit = CpuFeatures::Get();
+
+}  // namespace
+
+const char* AesPathName(AesPath path) {
+	switch (path) {
+		case AesPath::kPortable:
+			return "portable";
+		case AesPath::kAesNi:
+			return "aesni";
+		case AesPath::kVaes256:
+			return "vaes256";
+		case AesPath::kVaes512:
+			return "vaes512";
+	}
+	return "unknown";
+}
+
+const CpuFeatures& CpuFeatures::Get() {
+	static const CpuFeatures features = Detect();
+	return features;
+}
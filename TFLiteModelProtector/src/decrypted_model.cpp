@@ -0,0 +1,17 @@
+#include "decrypted_model.hpp"
+
+#include <utility>
+
+/**
+ * @brief Takes over another model. The current model is destroyed before its plaintext.
+ */
+DecryptedModel& DecryptedModel::operator=(DecryptedModel&& other) noexcept {
+	if (this != &other) {
+		model_ = std::move(other.model_);
+		buffer_ = std::move(other.buffer_);
+		source_ = std::move(other.source_);
+		content_digest_ = other.content_digest_;
+		timings_ = other.timings_;
+	}
+	return *this;
+}
@@ -0,0 +1,184 @@
+#include "locked_arena.hpp"
+
+#include <openssl/crypto.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+#include "logging.hpp"
+#include "protector_metrics.hpp"
+
+namespace {
+
+size_t RoundUp(size_t value, size_t alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+}  // namespace
+
+LockedArena::LockedArena(size_t region_size) : region_size_(region_size) {}
+
+LockedArena::~LockedArena() {
+	for (Region& region : regions_) {
+		UnmapRegion(region);
+	}
+}
+
+/**
+ * @brief Returns the process-wide arena used by BufferPolicy::kLockedArena.
+ */
+LockedArena& LockedArena::Instance() {
+	// Intentionally leaked so buffers released during static destruction can still return blocks.
+	static LockedArena* arena = new LockedArena();
+	return *arena;
+}
+
+/**
+ * @brief Carves a locked block of at least `size` bytes out of the arena.
+ *
+ * Existing regions are searched first-fit; a new region is mapped and locked only when none of
+ * them has a large enough free block. The block is not zero-filled.
+ *
+ * @param size The number of bytes required.
+ * @return The block, or nullptr if a new region could not be mapped or locked (for example
+ *         because RLIMIT_MEMLOCK is too low).
+ */
+char* LockedArena::Acquire(size_t size) {
+	const size_t length = RoundUp(std::max<size_t>(size, 1), kBlockAlignment);
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	for (Region& region : regions_) {
+		for (auto it = region.free_blocks.begin(); it != region.free_blocks.end(); ++it) {
+			if (it->second < length) {
+				continue;
+			}
+			char* block = it->first;
+			const size_t remaining = it->second - length;
+			region.free_blocks.erase(it);
+			if (remaining > 0) {
+				region.free_blocks.emplace(block + length, remaining);
+			}
+			ProtectorMetrics::Instance().RecordCacheHit(MetricsCache::kLockedArena);
+			return block;
+		}
+	}
+
+	ProtectorMetrics::Instance().RecordCacheMiss(MetricsCache::kLockedArena);
+	Region* region = MapRegion(length);
+	if (region == nullptr) {
+		return nullptr;
+	}
+	char* block = region->base;
+	if (region->length > length) {
+		region->free_blocks.emplace(block + length, region->length - length);
+	}
+	return block;
+}
+
+/**
+ * @brief Wipes a block and hands it back to the arena for reuse.
+ *
+ * @param block A pointer previously returned by Acquire().
+ * @param size The size passed to Acquire(). The whole block is wiped, not just the used part.
+ */
+void LockedArena::Return(char* block, size_t size) {
+	if (block == nullptr) {
+		return;
+	}
+	const size_t length = RoundUp(std::max<size_t>(size, 1), kBlockAlignment);
+	OPENSSL_cleanse(block, length);
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	for (Region& region : regions_) {
+		if (block < region.base || block >= region.base + region.length) {
+			continue;
+		}
+		auto it = region.free_blocks.emplace(block, length).first;
+		auto next = std::next(it);
+		if (next != region.free_blocks.end() && it->first + it->second == next->first) {
+			it->second += next->second;
+			region.free_blocks.erase(next);
+		}
+		if (it != region.free_blocks.begin()) {
+			auto prev = std::prev(it);
+			if (prev->first + prev->second == it->first) {
+				prev->second += it->second;
+				region.free_blocks.erase(it);
+			}
+		}
+		return;
+	}
+	LOGE("LockedArena::Return called with a foreign block");
+}
+
+/**
+ * @brief Unlocks and unmaps every region that has no outstanding blocks.
+ */
+void LockedArena::Trim() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	for (auto it = regions_.begin(); it != regions_.end();) {
+		const auto& free_blocks = it->free_blocks;
+		const bool idle = free_blocks.size() == 1 && free_blocks.begin()->first == it->base &&
+						  free_blocks.begin()->second == it->length;
+		if (idle) {
+			UnmapRegion(*it);
+			it = regions_.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+/**
+ * @brief Sets the size of regions mapped from now on. Larger blocks get a region of their own.
+ */
+void LockedArena::SetRegionSize(size_t region_size) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	region_size_ = region_size;
+}
+
+/**
+ * @brief Returns the number of bytes currently mapped and locked by the arena.
+ */
+size_t LockedArena::locked_bytes() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	size_t total = 0;
+	for (const Region& region : regions_) {
+		total += region.length;
+	}
+	return total;
+}
+
+LockedArena::Region* LockedArena::MapRegion(size_t min_length) {
+	const size_t length = RoundUp(std::max(min_length, region_size_), kBlockAlignment);
+	void* memory =
+		mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (memory == MAP_FAILED) {
+		LOGE("LockedArena: failed to map region");
+		return nullptr;
+	}
+	if (mlock(memory, length) != 0) {
+		LOGE("LockedArena: mlock failed, check RLIMIT_MEMLOCK");
+		munmap(memory, length);
+		return nullptr;
+	}
+	madvise(memory, length, MADV_DONTDUMP);
+	madvise(memory, length, MADV_DONTFORK);
+
+	Region region;
+	region.base = static_cast<char*>(memory);
+	region.length = length;
+	regions_.push_back(std::move(region));
+	return &regions_.back();
+}
+
+void LockedArena::UnmapRegion(Region& region) {
+	OPENSSL_cleanse(region.base, region.length);
+	munlock(region.base, region.length);
+	munmap(region.base, region.length);
+	region.base = nullptr;
+	region.length = 0;
+	region.free_blocks.clear();
+}
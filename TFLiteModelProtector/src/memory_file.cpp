@@ -0,0 +1,49 @@
+#include "memory_file.hpp"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <utility>
+
+MemoryFile::~MemoryFile() { Close(); }
+
+MemoryFile::MemoryFile(MemoryFile&& other) noexcept : fd_(std::exchange(other.fd_, -1)) {}
+
+MemoryFile& MemoryFile::operator=(MemoryFile&& other) noexcept {
+	if (this != &other) {
+		Close();
+		fd_ = std::exchange(other.fd_, -1);
+	}
+	return *this;
+}
+
+/**
+ * @brief Creates an empty memory file, closing any previous one.
+ *
+ * @param name A label shown in /proc/<pid>/fd, for debugging only.
+ * @return false if memfd_create() failed.
+ */
+bool MemoryFile::Create(const char* name) {
+	Close();
+	fd_ = memfd_create(name, MFD_CLOEXEC);
+	return fd_ >= 0;
+}
+
+/**
+ * @brief Closes the file. Its pages are freed once every mapping of it is gone as well, so it is
+ * safe to close while XNNPACK still maps the weights.
+ */
+void MemoryFile::Close() {
+	if (fd_ >= 0) {
+		close(fd_);
+		fd_ = -1;
+	}
+}
+
+std::string MemoryFile::path() const { return "/proc/self/fd/" + std::to_string(fd_); }
+
+size_t MemoryFile::size() const {
+	struct stat st = {};
+	return fd_ >= 0 && fstat(fd_, &st) == 0 ? static_cast<size_t>(st.st_size) : 0;
+}
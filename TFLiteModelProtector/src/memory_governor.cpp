@@ -0,0 +1,258 @@
+#include "memory_governor.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include "cgroup.hpp"
+#include "operation_control.hpp"
+
+namespace {
+
+bool ReadFirstWord(const std::string& path, std::string* word) {
+	std::ifstream in(path);
+	return static_cast<bool>(in >> *word);
+}
+
+}  // namespace
+
+MemoryGovernor::MemoryGovernor() : MemoryGovernor(Options()) {}
+
+MemoryGovernor::MemoryGovernor(const Options& options)
+	: options_(options),
+	  cgroup_dir_(options.cgroup_dir.empty() ? OwnCgroupDir() : options.cgroup_dir) {}
+
+MemoryGovernor::~MemoryGovernor() { StopMonitor(); }
+
+/**
+ * @brief Reads memory.current, memory.max, memory.stat and memory.pressure of the cgroup.
+ *
+ * Missing memory.stat or memory.pressure files (kernels without PSI) leave their parts at zero.
+ *
+ * @return false if the cgroup has no memory controller files; `snapshot` is then all zero.
+ */
+bool MemoryGovernor::ReadSnapshot(MemorySnapshot* snapshot) const {
+	*snapshot = MemorySnapshot();
+	std::string word;
+	if (!ReadFirstWord(cgroup_dir_ + "/memory.current", &word)) {
+		return false;
+	}
+	const uint64_t current = std::stoull(word);
+
+	if (ReadFirstWord(cgroup_dir_ + "/memory.max", &word) && word != "max") {
+		snapshot->limit = std::stoull(word);
+	}
+
+	uint64_t inactive_file = 0;
+	std::ifstream stat(cgroup_dir_ + "/memory.stat");
+	std::string key;
+	uint64_t value = 0;
+	while (stat >> key >> value) {
+		if (key == "inactive_file") {
+			inactive_file = value;
+			break;
+		}
+	}
+	snapshot->working_set = current - std::min(current, inactive_file);
+
+	std::ifstream pressure(cgroup_dir_ + "/memory.pressure");
+	std::string line;
+	while (std::getline(pressure, line)) {
+		const size_t avg10 = line.find("avg10=");
+		if (line.compare(0, 5, "some ") == 0 && avg10 != std::string::npos) {
+			snapshot->pressure = std::stod(line.substr(avg10 + 6));
+			break;
+		}
+	}
+	return true;
+}
+
+/**
+ * @brief Returns the byte budget for the working set, 0 for unlimited.
+ */
+uint64_t MemoryGovernor::Budget(const MemorySnapshot& snapshot) const {
+	if (options_.budget_bytes != 0) {
+		return options_.budget_bytes;
+	}
+	return static_cast<uint64_t>(static_cast<double>(snapshot.limit) * (1.0 - options_.headroom));
+}
+
+/**
+ * @brief Returns how many bytes would have to be freed before `bytes` more can be admitted.
+ *
+ * High pressure with no shortfall in bytes still asks for at least `bytes` (or one byte, so
+ * that reclaimers drop one model): the kernel is already reclaiming to keep up. Called with
+ * mutex_ held.
+ */
+uint64_t MemoryGovernor::Shortfall(const MemorySnapshot& snapshot, uint64_t bytes) const {
+	uint64_t shortfall = 0;
+	const uint64_t budget = Budget(snapshot);
+	const uint64_t needed = snapshot.working_set + reserved_ + bytes;
+	if (budget != 0 && needed > budget) {
+		shortfall = needed - budget;
+	}
+	if (snapshot.pressure > options_.max_pressure) {
+		shortfall = std::max(shortfall, std::max<uint64_t>(bytes, 1));
+	}
+	return shortfall;
+}
+
+/**
+ * @brief Admits a load that is about to allocate `bytes`, deferring it while memory is short.
+ *
+ * Each round evicts from the reclaimers first; if they cannot free enough, the load waits for
+ * other loads to finish or for the next poll, up to Options::max_defer. The wait also ends at
+ * the deadline of the calling thread's OperationControl, and at the first poll after it is
+ * cancelled.
+ *
+ * @return A reservation to hold until the buffer is allocated and filled, or an empty one if
+ *         the load was deferred for too long and should be rejected.
+ */
+MemoryGovernor::Reservation MemoryGovernor::Admit(uint64_t bytes) {
+	auto deadline = std::chrono::steady_clock::now() + options_.max_defer;
+	if (const OperationControl* control = OperationControl::Current()) {
+		deadline = std::min(deadline, control->deadline);
+	}
+	std::unique_lock<std::mutex> lock(mutex_);
+	while (true) {
+		MemorySnapshot snapshot;
+		ReadSnapshot(&snapshot);
+		const uint64_t shortfall = Shortfall(snapshot, bytes);
+		if (shortfall == 0) {
+			reserved_ += bytes;
+			return Reservation(this, bytes);
+		}
+
+		lock.unlock();
+		const uint64_t freed = Reclaim(shortfall);
+		lock.lock();
+		if (freed > 0) {
+			continue;
+		}
+		const auto now = std::chrono::steady_clock::now();
+		if (now >= deadline || OperationControl::Poll() != ProtectorStatus::kOk) {
+			return Reservation();
+		}
+		released_.wait_until(lock, std::min(now + options_.poll_interval, deadline));
+	}
+}
+
+/**
+ * @brief Evicts from the reclaimers if the cgroup is over budget or under pressure right now.
+ *
+ * @return The number of bytes the reclaimers freed.
+ */
+uint64_t MemoryGovernor::Rebalance() {
+	uint64_t shortfall = 0;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		MemorySnapshot snapshot;
+		if (!ReadSnapshot(&snapshot) && options_.budget_bytes == 0) {
+			return 0;
+		}
+		shortfall = Shortfall(snapshot, 0);
+	}
+	return shortfall > 0 ? Reclaim(shortfall) : 0;
+}
+
+/**
+ * @brief Asks the reclaimers in registration order until `wanted` bytes are freed.
+ */
+uint64_t MemoryGovernor::Reclaim(uint64_t wanted) {
+	std::lock_guard<std::mutex> lock(reclaim_mutex_);
+	uint64_t freed = 0;
+	for (auto& entry : reclaimers_) {
+		if (freed >= wanted) {
+			break;
+		}
+		freed += entry.second(wanted - freed);
+	}
+	return freed;
+}
+
+/**
+ * @brief Registers a reclaimer; it may be called from any thread that loads a model.
+ *
+ * @return An id for RemoveReclaimer().
+ */
+int MemoryGovernor::AddReclaimer(Reclaimer reclaimer) {
+	std::lock_guard<std::mutex> lock(reclaim_mutex_);
+	reclaimers_.emplace(next_reclaimer_, std::move(reclaimer));
+	return next_reclaimer_++;
+}
+
+/**
+ * @brief Unregisters a reclaimer. When this returns, the reclaimer is not running and will not
+ * be called again.
+ */
+void MemoryGovernor::RemoveReclaimer(int id) {
+	std::lock_guard<std::mutex> lock(reclaim_mutex_);
+	reclaimers_.erase(id);
+}
+
+uint64_t MemoryGovernor::reserved() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return reserved_;
+}
+
+void MemoryGovernor::Release(uint64_t bytes) {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		reserved_ -= bytes;
+	}
+	released_.notify_all();
+}
+
+/**
+ * @brief Starts a background thread that calls Rebalance() every `interval`, so caches shrink
+ * as soon as pressure builds rather than when the next load arrives.
+ */
+void MemoryGovernor::StartMonitor(std::chrono::milliseconds interval) {
+	StopMonitor();
+	std::lock_guard<std::mutex> lock(monitor_mutex_);
+	monitor_stop_ = false;
+	monitor_ = std::thread([this, interval]() {
+		std::unique_lock<std::mutex> lock(monitor_mutex_);
+		while (!monitor_wakeup_.wait_for(lock, interval, [this]() { return monitor_stop_; })) {
+			lock.unlock();
+			Rebalance();
+			lock.lock();
+		}
+	});
+}
+
+void MemoryGovernor::StopMonitor() {
+	{
+		std::lock_guard<std::mutex> lock(monitor_mutex_);
+		monitor_stop_ = true;
+	}
+	monitor_wakeup_.notify_all();
+	if (monitor_.joinable()) {
+		monitor_.join();
+	}
+}
+
+MemoryGovernor::Reservation::Reservation(Reservation&& other) noexcept
+	: governor_(other.governor_), bytes_(other.bytes_) {
+	other.governor_ = nullptr;
+}
+
+MemoryGovernor::Reservation& MemoryGovernor::Reservation::operator=(Reservation&& other) noexcept {
+	if (this != &other) {
+		Reset();
+		governor_ = other.governor_;
+		bytes_ = other.bytes_;
+		other.governor_ = nullptr;
+	}
+	return *this;
+}
+
+/**
+ * @brief Returns the bytes to the governor early, once the allocation is visible in the cgroup.
+ */
+void MemoryGovernor::Reservation::Reset() {
+	if (governor_ != nullptr) {
+		governor_->Release(bytes_);
+		governor_ = nullptr;
+	}
+}
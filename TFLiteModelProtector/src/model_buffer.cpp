@@ -0,0 +1,219 @@
+#include "model_buffer.hpp"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "locked_arena.hpp"
+#include "logging.hpp"
+#include "numa_placement.hpp"
+
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23	// Linux 5.14+, older headers lack the constant
+#endif
+
+namespace {
+
+size_t RoundUp(size_t value, size_t alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+/**
+ * @brief Faults in every page of a mapping so decryption does not pay first-touch costs.
+ *
+ * MADV_POPULATE_WRITE is preferred because it honours the huge page advice; on kernels without
+ * it one byte per `page_size` is touched instead.
+ */
+void PrefaultRange(char* data, size_t length, size_t page_size) {
+	if (madvise(data, length, MADV_POPULATE_WRITE) == 0) {
+		return;
+	}
+	for (size_t offset = 0; offset < length; offset += page_size) {
+		reinterpret_cast<volatile char*>(data)[offset] = 0;
+	}
+}
+
+}  // namespace
+
+ModelBuffer::~ModelBuffer() { Release(); }
+
+ModelBuffer::ModelBuffer(ModelBuffer&& other) noexcept { *this = std::move(other); }
+
+ModelBuffer& ModelBuffer::operator=(ModelBuffer&& other) noexcept {
+	if (this != &other) {
+		Release();
+		data_ = std::exchange(other.data_, nullptr);
+		size_ = std::exchange(other.size_, 0);
+		capacity_ = std::exchange(other.capacity_, 0);
+		mapped_length_ = std::exchange(other.mapped_length_, 0);
+		from_arena_ = std::exchange(other.from_arena_, false);
+		policy_ = std::exchange(other.policy_, BufferPolicy::kHeap);
+		numa_node_ = std::exchange(other.numa_node_, -1);
+	}
+	return *this;
+}
+
+/**
+ * @brief Allocates storage for at least `capacity` bytes of plaintext.
+ *
+ * Any previous allocation is released first. Huge page policies fall back to the next weaker
+ * policy (hugetlbfs -> THP -> heap) when the kernel refuses the mapping. kLockedArena never falls
+ * back, since handing out swappable memory would defeat its purpose.
+ *
+ * @param capacity The number of bytes the decryptor may write.
+ * @param policy The backing store to use.
+ * @param prefault If true, all pages are faulted in before the call returns.
+ * @param numa_node If non-negative, the pages are bound to this NUMA node. Heap buffers are then
+ *        served from an anonymous mapping, since heap pages cannot be bound individually.
+ *        Locked arena blocks ignore the node. numa_node() tells whether the binding took.
+ * @return true on success, false if the allocation failed.
+ */
+bool ModelBuffer::Allocate(size_t capacity, BufferPolicy policy, bool prefault, int numa_node) {
+	Release();
+	if (capacity == 0) {
+		return true;
+	}
+
+	if (policy == BufferPolicy::kLockedArena) {
+		// Arena regions are locked, hence resident, so prefaulting is implicit.
+		data_ = LockedArena::Instance().Acquire(capacity);
+		if (data_ == nullptr) {
+			return false;
+		}
+		capacity_ = capacity;
+		from_arena_ = true;
+		policy_ = BufferPolicy::kLockedArena;
+		return true;
+	}
+
+	if ((policy != BufferPolicy::kHeap || numa_node >= 0) &&
+		MapPages(capacity, policy, prefault, numa_node)) {
+		return true;
+	}
+
+	void* memory = nullptr;
+	if (posix_memalign(&memory, kHeapAlignment, capacity) != 0) {
+		LOGE("Failed to allocate model buffer");
+		return false;
+	}
+	data_ = static_cast<char*>(memory);
+	capacity_ = capacity;
+	policy_ = BufferPolicy::kHeap;
+	if (prefault) {
+		std::memset(data_, 0, capacity_);
+	}
+	return true;
+}
+
+bool ModelBuffer::MapPages(size_t capacity, BufferPolicy policy, bool prefault, int numa_node) {
+	const bool huge = policy != BufferPolicy::kHeap;
+	const size_t alignment = huge ? kHugePageSize : static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	const size_t length = RoundUp(capacity, alignment);
+
+	if (policy == BufferPolicy::kHugeTlbFs) {
+		// Populating has to wait for the NUMA binding, if any.
+		int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB;
+		if (prefault && numa_node < 0) {
+			flags |= MAP_POPULATE;
+		}
+		void* memory = mmap(nullptr, length, PROT_READ | PROT_WRITE, flags, -1, 0);
+		if (memory != MAP_FAILED) {
+			bool bound = false;
+			if (numa_node >= 0) {
+				bound = NumaTopology::BindMemory(memory, length, numa_node);
+				if (prefault) {
+					PrefaultRange(static_cast<char*>(memory), length, alignment);
+				}
+			}
+			data_ = static_cast<char*>(memory);
+			capacity_ = capacity;
+			mapped_length_ = length;
+			policy_ = BufferPolicy::kHugeTlbFs;
+			numa_node_ = bound ? numa_node : -1;
+			return true;
+		}
+		LOGI("hugetlbfs mapping unavailable, falling back to transparent huge pages");
+	}
+
+	// For huge pages, over-reserve by one huge page and trim both ends so the region starts on a
+	// 2 MB boundary, otherwise khugepaged can only collapse the interior of the buffer.
+	const size_t reserve = huge ? length + kHugePageSize : length;
+	void* memory = mmap(nullptr, reserve, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+						-1, 0);
+	if (memory == MAP_FAILED) {
+		return false;
+	}
+	char* base = static_cast<char*>(memory);
+	char* aligned = reinterpret_cast<char*>(
+		RoundUp(reinterpret_cast<uintptr_t>(base), alignment));
+	const size_t head = aligned - base;
+	const size_t tail = reserve - head - length;
+	if (head > 0) {
+		munmap(base, head);
+	}
+	if (tail > 0) {
+		munmap(aligned + length, tail);
+	}
+
+	bool bound = false;
+	if (numa_node >= 0) {
+		bound = NumaTopology::BindMemory(aligned, length, numa_node);
+		if (!bound) {
+			LOGI("mbind failed, model buffer is not bound to NUMA node " +
+				 std::to_string(numa_node));
+		}
+	}
+	if (huge) {
+		madvise(aligned, length, MADV_HUGEPAGE);
+	}
+	// MAP_POPULATE would fault 4 KB pages before the advice above applies, so populate afterwards.
+	if (prefault) {
+		PrefaultRange(aligned, length, alignment);
+	}
+
+	data_ = aligned;
+	capacity_ = capacity;
+	mapped_length_ = length;
+	policy_ = huge ? BufferPolicy::kTransparentHugePages : BufferPolicy::kHeap;
+	numa_node_ = bound ? numa_node : -1;
+	return true;
+}
+
+/**
+ * @brief Frees the allocation. The buffer is empty afterwards and may be reused.
+ */
+void ModelBuffer::Release() {
+	if (data_ != nullptr) {
+		if (from_arena_) {
+			LockedArena::Instance().Return(data_, capacity_);
+		} else if (mapped_length_ > 0) {
+			munmap(data_, mapped_length_);
+		} else {
+			std::free(data_);
+		}
+	}
+	data_ = nullptr;
+	size_ = 0;
+	capacity_ = 0;
+	mapped_length_ = 0;
+	from_arena_ = false;
+	numa_node_ = -1;
+}
+
+/**
+ * @brief Sets the number of valid bytes. Never reallocates.
+ *
+ * @throws std::length_error if `size` exceeds the allocated capacity.
+ */
+void ModelBuffer::Resize(size_t size) {
+	if (size > capacity_) {
+		throw std::length_error("ModelBuffer resize beyond capacity");
+	}
+	size_ = size;
+}
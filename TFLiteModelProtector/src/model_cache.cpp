@@ -0,0 +1,142 @@
+#include "model_cache.hpp"
+
+/**
+ * @param protector Loads missing models; must outlive the cache.
+ * @param capacity_bytes Plaintext bytes kept resident, 0 for no limit other than the governor's.
+ * @param governor If set, the cache registers as one of its reclaimers.
+ */
+ModelCache::ModelCache(TFLiteModelProtector& protector, uint64_t capacity_bytes,
+					   std::shared_ptr<MemoryGovernor> governor)
+	: protector_(protector), capacity_bytes_(capacity_bytes), governor_(std::move(governor)) {
+	if (governor_) {
+		reclaimer_id_ =
+			governor_->AddReclaimer([this](uint64_t wanted) { return Evict(wanted); });
+	}
+}
+
+ModelCache::~ModelCache() {
+	if (governor_) {
+		governor_->RemoveReclaimer(reclaimer_id_);
+	}
+}
+
+/**
+ * @brief Returns the model for `model_path`, loading it if it is not cached or has changed.
+ *
+ * A file counts as changed when its inode, size or mtime differ from the cached load, so a
+ * model replaced by rename is picked up on the next call.
+ *
+ * @return The model, or nullptr if loading failed (see TFLiteModelProtector::LastStatus()).
+ */
+std::shared_ptr<const DecryptedModel> ModelCache::Get(const std::string& model_path) {
+	struct stat st = {};
+	const bool have_stat = stat(model_path.c_str(), &st) == 0;
+	const int64_t mtime_ns =
+		static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto found = index_.find(model_path);
+		if (found != index_.end()) {
+			const Entry& entry = *found->second;
+			if (have_stat && entry.inode == static_cast<uint64_t>(st.st_ino) &&
+				entry.file_size == static_cast<uint64_t>(st.st_size) &&
+				entry.mtime_ns == mtime_ns) {
+				lru_.splice(lru_.begin(), lru_, found->second);
+				ProtectorMetrics::Instance().RecordCacheHit(MetricsCache::kModelCache);
+				return entry.model;
+			}
+			EraseLocked(found->second);
+		}
+	}
+	ProtectorMetrics::Instance().RecordCacheMiss(MetricsCache::kModelCache);
+
+	// Loaded without the cache lock: the governor may call Evict() from inside the load.
+	std::shared_ptr<const DecryptedModel> model = protector_.LoadSharedModel(model_path);
+	if (!model || !have_stat) {
+		return model;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto found = index_.find(model_path);
+	if (found != index_.end()) {
+		EraseLocked(found->second);
+	}
+	lru_.push_front(Entry{model_path, static_cast<uint64_t>(st.st_ino),
+						  static_cast<uint64_t>(st.st_size), mtime_ns, model});
+	index_.emplace(model_path, lru_.begin());
+	if (holders_[model.get()]++ == 0) {
+		resident_bytes_ += model->size();
+	}
+	if (capacity_bytes_ != 0 && resident_bytes_ > capacity_bytes_) {
+		EvictLocked(resident_bytes_ - capacity_bytes_, false);
+	}
+	return model;
+}
+
+/**
+ * @brief Drops least recently used models that nobody outside the cache holds, until `bytes`
+ * are freed. Models still in use are skipped, since dropping them would free nothing.
+ *
+ * @return The plaintext bytes released.
+ */
+uint64_t ModelCache::Evict(uint64_t bytes) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return EvictLocked(bytes, true);
+}
+
+void ModelCache::Clear() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	lru_.clear();
+	index_.clear();
+	holders_.clear();
+	resident_bytes_ = 0;
+}
+
+uint64_t ModelCache::resident_bytes() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return resident_bytes_;
+}
+
+size_t ModelCache::size() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return lru_.size();
+}
+
+/**
+ * @brief Evicts from the least recently used end. The most recent entry is never evicted for
+ * capacity, so a single model larger than the capacity still stays until the next load.
+ */
+uint64_t ModelCache::EvictLocked(uint64_t bytes, bool unused_only) {
+	uint64_t freed = 0;
+	auto it = lru_.end();
+	while (freed < bytes && it != lru_.begin()) {
+		--it;
+		if (!unused_only && it == lru_.begin()) {
+			break;
+		}
+		if (unused_only &&
+			static_cast<size_t>(it->model.use_count()) > holders_[it->model.get()]) {
+			continue;
+		}
+		auto victim = it++;
+		freed += EraseLocked(victim);
+	}
+	return freed;
+}
+
+/**
+ * @brief Removes one entry and returns the bytes released, which is zero while another entry
+ * still holds the same model.
+ */
+uint64_t ModelCache::EraseLocked(Lru::iterator it) {
+	uint64_t released = 0;
+	auto holder = holders_.find(it->model.get());
+	if (--holder->second == 0) {
+		holders_.erase(holder);
+		released = it->model->size();
+		resident_bytes_ -= released;
+	}
+	index_.erase(it->path);
+	lru_.erase(it);
+	return released;
+}
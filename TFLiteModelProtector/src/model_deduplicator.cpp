@@ -0,0 +1,84 @@
+#include "model_deduplicator.hpp"
+
+#include <cstring>
+#include <vector>
+
+/**
+ * @brief Returns the process-wide table.
+ */
+ModelDeduplicator& ModelDeduplicator::Instance() {
+	// Leaked like ProtectorMetrics::Instance(): the deleters of shared models refer to it.
+	static ModelDeduplicator* deduplicator = new ModelDeduplicator();
+	return *deduplicator;
+}
+
+/**
+ * @brief Returns a shared model with the same plaintext as `model`, adding `model` if there is
+ * none.
+ *
+ * Candidates with the same digest are compared outside the table lock, so comparing a large
+ * model does not stall unrelated loads. Only models in the same kind of buffer, bound to the same
+ * NUMA node, are shared: a load that asked for locked memory never receives a swappable copy,
+ * and a load placed on one node never receives a copy on another. When two identical models are
+ * interned at the same moment, both may be added; later loads then share whichever they find
+ * first.
+ *
+ * @param model A freshly decrypted model. It is released if an identical one already exists.
+ * @param shared Set to true if an existing model was returned instead of `model`.
+ */
+std::shared_ptr<const DecryptedModel> ModelDeduplicator::Intern(DecryptedModel model,
+																bool* shared) {
+	const uint64_t digest = model.content_digest();
+	std::vector<std::shared_ptr<const DecryptedModel>> candidates;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto range = entries_.equal_range(digest);
+		for (auto it = range.first; it != range.second; ++it) {
+			std::shared_ptr<const DecryptedModel> candidate = it->second.handle.lock();
+			if (candidate) {
+				candidates.push_back(std::move(candidate));
+			}
+		}
+	}
+	for (std::shared_ptr<const DecryptedModel>& candidate : candidates) {
+		if (candidate->size() == model.size() &&
+			candidate->buffer().policy() == model.buffer().policy() &&
+			candidate->buffer().numa_node() == model.buffer().numa_node() &&
+			std::memcmp(candidate->data(), model.data(), model.size()) == 0) {
+			if (shared != nullptr) {
+				*shared = true;
+			}
+			return std::move(candidate);
+		}
+	}
+
+	const DecryptedModel* owned = new DecryptedModel(std::move(model));
+	std::shared_ptr<const DecryptedModel> handle(owned, [digest](const DecryptedModel* released) {
+		ModelDeduplicator::Instance().Forget(digest, released);
+		delete released;
+	});
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		entries_.emplace(digest, Entry{owned, handle});
+	}
+	if (shared != nullptr) {
+		*shared = false;
+	}
+	return handle;
+}
+
+size_t ModelDeduplicator::size() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return entries_.size();
+}
+
+void ModelDeduplicator::Forget(uint64_t digest, const DecryptedModel* model) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto range = entries_.equal_range(digest);
+	for (auto it = range.first; it != range.second; ++it) {
+		if (it->second.model == model) {
+			entries_.erase(it);
+			return;
+		}
+	}
+}
@@ -0,0 +1,169 @@
+#include "model_format.hpp"
+
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+
+#include <cstring>
+
+namespace {
+
+constexpr uint8_t kMagic[4] = {'T', 'F', 'M', 'P'};
+constexpr uint8_t kDeltaMagic[4] = {'T', 'F', 'M', 'D'};
+constexpr uint8_t kKeyCheckTweak[16] = {'T', 'F', 'L', 'i', 't', 'e', 'P', 'r',
+										'o', 't', 'e', 'c', 't', 'o', 'r', '!'};
+constexpr size_t kBlockSize = 16;
+
+void PutLe(uint8_t* out, uint64_t value, size_t bytes) {
+	for (size_t i = 0; i < bytes; ++i) {
+		out[i] = static_cast<uint8_t>(value >> (8 * i));
+	}
+}
+
+uint64_t GetLe(const uint8_t* in, size_t bytes) {
+	uint64_t value = 0;
+	for (size_t i = 0; i < bytes; ++i) {
+		value |= static_cast<uint64_t>(in[i]) << (8 * i);
+	}
+	return value;
+}
+
+}  // namespace
+
+const char* ProtectorStatusName(ProtectorStatus status) {
+	switch (status) {
+		case ProtectorStatus::kOk:
+			return "ok";
+		case ProtectorStatus::kFileOpenError:
+			return "file_open_error";
+		case ProtectorStatus::kIoError:
+			return "io_error";
+		case ProtectorStatus::kBadHeader:
+			return "bad_header";
+		case ProtectorStatus::kWrongKey:
+			return "wrong_key";
+		case ProtectorStatus::kTruncated:
+			return "truncated";
+		case ProtectorStatus::kCipherError:
+			return "cipher_error";
+		case ProtectorStatus::kAllocationError:
+			return "allocation_error";
+		case ProtectorStatus::kChecksumMismatch:
+			return "checksum_mismatch";
+		case ProtectorStatus::kBufferTooSmall:
+			return "buffer_too_small";
+		case ProtectorStatus::kInvalidModel:
+			return "invalid_model";
+		case ProtectorStatus::kMemoryPressure:
+			return "memory_pressure";
+		case ProtectorStatus::kCancelled:
+			return "cancelled";
+		case ProtectorStatus::kDeadlineExceeded:
+			return "deadline_exceeded";
+	}
+	return "unknown";
+}
+
+void ModelHeader::Serialize(uint8_t* out) const {
+	std::memset(out, 0, kSize);
+	std::memcpy(out, kMagic, sizeof(kMagic));
+	out[4] = version;
+	out[5] = cipher;
+	PutLe(out + 6, flags, 2);
+	PutLe(out + 8, plaintext_size, 8);
+	std::memcpy(out + 16, key_check, kKeyCheckLength);
+	PutLe(out + 24, content_digest, 8);
+}
+
+bool ModelHeader::HasMagic(const uint8_t* in, size_t length) {
+	return length >= kSize && std::memcmp(in, kMagic, sizeof(kMagic)) == 0;
+}
+
+/**
+ * @brief Parses a serialized header.
+ *
+ * @return false if the magic is missing, the version or cipher is not supported, or the
+ *         plaintext size is beyond kMaxPlaintextSize (a corrupt size field).
+ */
+bool ModelHeader::Parse(const uint8_t* in, size_t length, ModelHeader* header) {
+	if (!HasMagic(in, length)) {
+		return false;
+	}
+	header->version = in[4];
+	header->cipher = in[5];
+	header->flags = static_cast<uint16_t>(GetLe(in + 6, 2));
+	header->plaintext_size = GetLe(in + 8, 8);
+	std::memcpy(header->key_check, in + 16, kKeyCheckLength);
+	header->content_digest = GetLe(in + 24, 8);
+	return header->version == kVersion &&
+		   (header->cipher == kCipherAes256Cbc || header->cipher == kCipherAes256CbcChunked) &&
+		   header->plaintext_size <= kMaxPlaintextSize;
+}
+
+bool ModelHeader::ComputeKeyCheck(const uint8_t* key, const uint8_t* iv, uint8_t* key_check) {
+	uint8_t block[kBlockSize];
+	uint8_t encrypted[2 * kBlockSize];
+	for (size_t i = 0; i < kBlockSize; ++i) {
+		block[i] = iv[i] ^ kKeyCheckTweak[i];
+	}
+
+	EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+	int out_len = 0;
+	const bool ok = EVP_EncryptInit_ex(ctx, EVP_aes_256_ecb(), nullptr, key, nullptr) == 1 &&
+					EVP_CIPHER_CTX_set_padding(ctx, 0) == 1 &&
+					EVP_EncryptUpdate(ctx, encrypted, &out_len, block, kBlockSize) == 1;
+	EVP_CIPHER_CTX_free(ctx);
+
+	if (ok) {
+		std::memcpy(key_check, encrypted, kKeyCheckLength);
+	}
+	OPENSSL_cleanse(block, sizeof(block));
+	return ok;
+}
+
+/**
+ * @brief Returns the CBC body size for a plaintext of the given size (PKCS#7 adds 1-16 bytes).
+ *
+ * `plaintext_size` must not exceed kMaxPlaintextSize, which Parse() guarantees for read headers.
+ */
+size_t ModelHeader::CipherSize(uint64_t plaintext_size) {
+	return static_cast<size_t>((plaintext_size / kBlockSize + 1) * kBlockSize);
+}
+
+/**
+ * @brief Returns the number of chunks in a chunked body, the padded last one included.
+ */
+uint64_t ModelHeader::chunk_count() const {
+	return (CipherSize(plaintext_size) + kChunkSize - 1) / kChunkSize;
+}
+
+void DeltaHeader::Serialize(uint8_t* out) const {
+	std::memset(out, 0, kSize);
+	std::memcpy(out, kDeltaMagic, sizeof(kDeltaMagic));
+	out[4] = version;
+	PutLe(out + 8, base_size, 8);
+	PutLe(out + 16, base_digest, 8);
+	PutLe(out + 24, chunk_count, 8);
+	target.Serialize(out + 32);
+}
+
+/**
+ * @brief Parses a delta header.
+ *
+ * @return false if the magic or version is wrong, or the target is not a chunked file.
+ */
+bool DeltaHeader::Parse(const uint8_t* in, size_t length, DeltaHeader* header) {
+	if (length < kSize || std::memcmp(in, kDeltaMagic, sizeof(kDeltaMagic)) != 0) {
+		return false;
+	}
+	header->version = in[4];
+	header->base_size = GetLe(in + 8, 8);
+	header->base_digest = GetLe(in + 16, 8);
+	header->chunk_count = GetLe(in + 24, 8);
+	return header->version == kVersion &&
+		   ModelHeader::Parse(in + 32, ModelHeader::kSize, &header->target) &&
+		   header->target.is_chunked();
+}
+
+void DeltaHeader::SerializeIndex(uint64_t index, uint8_t* out) { PutLe(out, index, kIndexSize); }
+
+uint64_t DeltaHeader::ParseIndex(const uint8_t* in) { return GetLe(in, kIndexSize); }
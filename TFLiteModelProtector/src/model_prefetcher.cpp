@@ -0,0 +1,131 @@
+#include "model_prefetcher.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <memory>
+
+#include "trace_events.hpp"
+
+namespace {
+
+constexpr size_t kReadStep = 1 << 20;
+
+}  // namespace
+
+/**
+ * @param mode How each file is brought into the page cache.
+ * @param threads Most files prefetched at once; at least one. More than one helps only when the
+ * files live on storage that serves parallel requests well, such as NVMe.
+ * @param policy Selects the shared pool the files are read on; by default it uses idle CPU and
+ * disk time only.
+ */
+ModelPrefetcher::ModelPrefetcher(Mode mode, size_t threads, const ThreadPolicy& policy)
+	: mode_(mode),
+	  max_lanes_(std::max<size_t>(threads, 1)),
+	  executor_(TaskExecutor::Default(policy)) {}
+
+/**
+ * @brief Abandons files still queued and waits for the ones in progress.
+ */
+ModelPrefetcher::~ModelPrefetcher() {
+	std::unique_lock<std::mutex> lock(mutex_);
+	queue_.clear();
+	idle_.wait(lock, [this]() { return lanes_ == 0; });
+}
+
+/**
+ * @brief Queues one file for prefetching and returns immediately.
+ */
+void ModelPrefetcher::Prefetch(const std::string& path) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	queue_.push_back(path);
+	StartLanes();
+}
+
+/**
+ * @brief Queues several files, prefetched in the given order.
+ */
+void ModelPrefetcher::Prefetch(const std::vector<std::string>& paths) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	queue_.insert(queue_.end(), paths.begin(), paths.end());
+	StartLanes();
+}
+
+/**
+ * @brief Blocks until every queued file has been handled.
+ */
+void ModelPrefetcher::Wait() {
+	std::unique_lock<std::mutex> lock(mutex_);
+	idle_.wait(lock, [this]() { return queue_.empty() && lanes_ == 0; });
+}
+
+/**
+ * @brief Submits a Drain() task per queued file, up to `threads` at once. Called with the lock
+ * held.
+ */
+void ModelPrefetcher::StartLanes() {
+	while (lanes_ < max_lanes_ && lanes_ < queue_.size()) {
+		++lanes_;
+		executor_.Submit([this]() { Drain(); });
+	}
+}
+
+/**
+ * @brief Prefetches queued files until the queue is empty.
+ */
+void ModelPrefetcher::Drain() {
+	std::unique_lock<std::mutex> lock(mutex_);
+	while (!queue_.empty()) {
+		const std::string path = std::move(queue_.front());
+		queue_.pop_front();
+		lock.unlock();
+		PrefetchFile(path);
+		lock.lock();
+	}
+	if (--lanes_ == 0) {
+		idle_.notify_all();
+	}
+}
+
+/**
+ * @brief Brings one file into the page cache.
+ *
+ * Both modes start with WILLNEED over the whole file so the kernel can issue large requests. In
+ * kRead mode the file is then read in 1 MiB steps, which waits for the I/O and also covers
+ * filesystems that ignore the advice.
+ */
+void ModelPrefetcher::PrefetchFile(const std::string& path) {
+	ScopedTrace trace("prefetch", path);
+	const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		return;
+	}
+	const size_t size = static_cast<size_t>(st.st_size);
+	posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+
+	if (mode_ == Mode::kRead) {
+		std::unique_ptr<char[]> scratch(new char[kReadStep]);
+		size_t offset = 0;
+		while (offset < size) {
+			const ssize_t n = pread(fd, scratch.get(), kReadStep, static_cast<off_t>(offset));
+			if (n < 0 && errno == EINTR) {
+				continue;
+			}
+			if (n <= 0) {
+				break;
+			}
+			offset += static_cast<size_t>(n);
+		}
+	}
+	close(fd);
+	prefetched_bytes_.fetch_add(size, std::memory_order_relaxed);
+}
@@ -1,12 +1,18 @@
 #include "model_protector.hpp"
 
-std::mutex TFLiteModelProtector::mutex_;
+std::timed_mutex TFLiteModelProtector::mutex_;
+thread_local ProtectorStatus TFLiteModelProtector::last_status_ = ProtectorStatus::kOk;
+SingleFlight<TFLiteModelProtector::LoadKey, TFLiteModelProtector::SharedLoad>
+	TFLiteModelProtector::in_flight_loads_;
 
 /**
  * @brief Encrypts the contents of an input file and writes the encrypted data to an output file.
  *
  * This function uses AES-256-CBC encryption to encrypt the contents of the specified input file.
- * The encrypted data is then written to the specified output file.
+ * The encrypted data is written to the specified output file behind a ModelHeader that records
+ * the plaintext size, a key check value and an XXH3 digest of the plaintext. The digest is
+ * computed on each chunk as it is read and the header is rewritten once it is known. If the
+ * calling thread's OperationControl abandons the encryption, the partial output is removed.
  *
  * @param input_file The path to the input file to be encrypted.
  * @param output_file The path to the output file where the encrypted data will be written.
@@ -14,30 +20,531 @@ std::mutex TFLiteModelProtector::mutex_;
  */
 bool TFLiteModelProtector::EncryptFile(const std::string& input_file,
 									   const std::string& output_file) {
-	std::ifstream in(input_file, std::ios::binary);
+	ScopedTrace trace("EncryptFile", input_file);
+	last_status_ = ProtectorStatus::kOk;
+	std::ifstream in(input_file, std::ios::binary | std::ios::ate);
 	std::ofstream out(output_file, std::ios::binary);
 
 	if (!in || !out) {
-		LOGE("File open error!");
-		return false;
+		return Fail(ProtectorStatus::kFileOpenError, "File open error!");
 	}
 
-	EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
-	EVP_EncryptInit_ex(ctx, EVP_aes_256_cbc(), nullptr, kEncryptionKey, kEncryptionIv);
+	ModelHeader header;
+	header.plaintext_size = static_cast<uint64_t>(in.tellg());
+	if (chunked_output_) {
+		header.cipher = ModelHeader::kCipherAes256CbcChunked;
+	}
+	in.seekg(0);
+	if (!ModelHeader::ComputeKeyCheck(kEncryptionKey, kEncryptionIv, header.key_check)) {
+		return Fail(ProtectorStatus::kCipherError, "Failed to compute key check value");
+	}
+	uint8_t header_bytes[ModelHeader::kSize];
+	header.Serialize(header_bytes);
+	out.write(reinterpret_cast<char*>(header_bytes), sizeof(header_bytes));
 
-	std::vector<uint8_t> buffer(4096);
-	std::vector<uint8_t> cipher_buffer(4096 + EVP_MAX_BLOCK_LENGTH);
-	int out_len = 0;
+	ChunkedCbcEncryptor encryptor(kEncryptionKey, kEncryptionIv, header.chunk_size());
+	bool ok = true;
 
-	while (in.read(reinterpret_cast<char*>(buffer.data()), buffer.size()) || in.gcount()) {
-		EVP_EncryptUpdate(ctx, cipher_buffer.data(), &out_len, buffer.data(), in.gcount());
+	std::vector<uint8_t> buffer(kIoChunkSize);
+	std::vector<uint8_t> cipher_buffer(kIoChunkSize + EVP_MAX_BLOCK_LENGTH);
+	Xxh3Hasher hasher;
+	size_t out_len = 0;
+	uint64_t done = 0;
+	ProtectorStatus control = OperationControl::Poll(done, header.plaintext_size);
+
+	while (ok && control == ProtectorStatus::kOk &&
+		   (in.read(reinterpret_cast<char*>(buffer.data()), buffer.size()) || in.gcount())) {
+		ScopedTrace chunk_trace("encrypt");
+		hasher.Update(buffer.data(), in.gcount());
+		ok = encryptor.Update(buffer.data(), in.gcount(), cipher_buffer.data(), &out_len);
 		out.write(reinterpret_cast<char*>(cipher_buffer.data()), out_len);
+		done += static_cast<uint64_t>(in.gcount());
+		control = OperationControl::Poll(done, header.plaintext_size);
+	}
+	if (control != ProtectorStatus::kOk) {
+		out.close();
+		std::remove(output_file.c_str());
+		return Fail(control, "Encryption abandoned: " + input_file);
 	}
 
-	EVP_EncryptFinal_ex(ctx, cipher_buffer.data(), &out_len);
+	ok = ok && encryptor.Final(cipher_buffer.data(), &out_len);
 	out.write(reinterpret_cast<char*>(cipher_buffer.data()), out_len);
 
-	EVP_CIPHER_CTX_free(ctx);
+	header.flags |= ModelHeader::kFlagContentDigest;
+	header.content_digest = hasher.Digest();
+	header.Serialize(header_bytes);
+	out.seekp(0);
+	out.write(reinterpret_cast<char*>(header_bytes), sizeof(header_bytes));
+
+	if (!ok) {
+		return Fail(ProtectorStatus::kCipherError, "Encryption failed: " + input_file);
+	}
+	if (!out) {
+		return Fail(ProtectorStatus::kIoError, "Write error: " + output_file);
+	}
+	return true;
+}
+
+/**
+ * @brief Checks that an encrypted file decrypts back to the given plaintext file.
+ *
+ * The encrypted file is decrypted chunk by chunk and each chunk is compared with the same range
+ * of the original, so memory use is two kIoChunkSize buffers regardless of the model size. The
+ * content digest in the header, if any, is checked as well.
+ *
+ * @param plain_file The original, unencrypted file.
+ * @param encrypted_file The file produced by EncryptFile() from `plain_file`.
+ * @return true if the round trip reproduces `plain_file` exactly, false otherwise.
+ */
+bool TFLiteModelProtector::VerifyEncryptedFile(const std::string& plain_file,
+											   const std::string& encrypted_file) {
+	last_status_ = ProtectorStatus::kOk;
+	std::ifstream plain(plain_file, std::ios::binary | std::ios::ate);
+	SequentialFile cipher;
+	EncryptedFileInfo info;
+
+	if (!plain) {
+		return Fail(ProtectorStatus::kFileOpenError, "File open error!");
+	}
+	if (!OpenEncryptedFile(encrypted_file, cipher, &info)) {
+		return false;
+	}
+
+	const size_t plain_size = static_cast<size_t>(plain.tellg());
+	plain.seekg(0);
+	if (info.body_size != ModelHeader::CipherSize(plain_size) ||
+		(info.has_header && info.plaintext_capacity != plain_size)) {
+		return Fail(ProtectorStatus::kTruncated,
+					"Verify failed: encrypted size does not match " + plain_file);
+	}
+
+	ChunkedCbcDecryptor decryptor(kEncryptionKey, kEncryptionIv, info.chunk_size());
+	Xxh3Hasher hasher;
+	std::vector<uint8_t> cipher_chunk(kIoChunkSize);
+	std::vector<uint8_t> plain_chunk(kIoChunkSize);
+	const size_t bulk_size = info.body_size - AesCbcDecryptor::kBlockSize;
+
+	for (size_t offset = 0; offset < bulk_size;) {
+		const ProtectorStatus control = OperationControl::Poll(offset, bulk_size);
+		if (control != ProtectorStatus::kOk) {
+			return Fail(control, "Verify abandoned: " + encrypted_file);
+		}
+		const size_t length = std::min(kIoChunkSize, bulk_size - offset);
+		if (!cipher.Read(cipher_chunk.data(), length) ||
+			!plain.read(reinterpret_cast<char*>(plain_chunk.data()), length)) {
+			return Fail(ProtectorStatus::kIoError,
+						"Verify failed: read error at offset " + std::to_string(offset));
+		}
+		decryptor.DecryptBlocks(cipher_chunk.data(), cipher_chunk.data(),
+								length / AesCbcDecryptor::kBlockSize);
+		if (std::memcmp(cipher_chunk.data(), plain_chunk.data(), length) != 0) {
+			return Fail(ProtectorStatus::kWrongKey,
+						"Verify failed: content mismatch in chunk at offset " +
+							std::to_string(offset));
+		}
+		hasher.Update(cipher_chunk.data(), length);
+		offset += length;
+	}
+
+	uint8_t last_cipher[AesCbcDecryptor::kBlockSize];
+	uint8_t last_plain[AesCbcDecryptor::kBlockSize];
+	uint8_t expected_tail[AesCbcDecryptor::kBlockSize];
+	const size_t expected_length = plain_size - bulk_size;
+	size_t tail = 0;
+	if (!cipher.Read(last_cipher, sizeof(last_cipher)) ||
+		!plain.read(reinterpret_cast<char*>(expected_tail), expected_length)) {
+		return Fail(ProtectorStatus::kIoError, "Verify failed: read error in final block");
+	}
+	if (!DecryptFinalBlock(decryptor.chaining_value(), last_cipher, last_plain, &tail) ||
+		tail != expected_length || std::memcmp(last_plain, expected_tail, tail) != 0) {
+		return Fail(ProtectorStatus::kWrongKey, "Verify failed: final block does not match");
+	}
+	hasher.Update(last_plain, tail);
+	if (info.has_header && info.header.has_content_digest() &&
+		hasher.Digest() != info.header.content_digest) {
+		return Fail(ProtectorStatus::kChecksumMismatch, "Verify failed: content digest mismatch");
+	}
+	return true;
+}
+
+/**
+ * @brief Re-encrypts a file from the current key and IV to a new key and IV in a single pass.
+ *
+ * Each chunk is decrypted with the current key and immediately encrypted with the new one, so
+ * plaintext only ever exists in one kIoChunkSize buffer, which is wiped before returning. The
+ * result is written to a temporary file next to `output_file` and renamed over it on success,
+ * which makes in-place rotation (`input_file == output_file`) safe. The plaintext digest is
+ * checked against the old header and written to the new one; legacy inputs gain one. Chunked
+ * inputs stay chunked.
+ *
+ * @param input_file The file encrypted with the key set on this protector.
+ * @param output_file The path for the re-encrypted file.
+ * @param new_key The new AES key, kAesKeyLength bytes.
+ * @param new_iv The new AES IV, kAesIvLength bytes.
+ * @return true on success, false otherwise. On failure `output_file` is left untouched.
+ *
+ * @throws std::invalid_argument If the size of the new key or IV is wrong.
+ */
+bool TFLiteModelProtector::ReEncrypt(const std::string& input_file, const std::string& output_file,
+									 const std::vector<uint8_t>& new_key,
+									 const std::vector<uint8_t>& new_iv) {
+	if (new_key.size() != kAesKeyLength || new_iv.size() != kAesIvLength) {
+		throw std::invalid_argument("Invalid key or IV length");
+	}
+	ScopedTrace trace("ReEncrypt", input_file);
+	last_status_ = ProtectorStatus::kOk;
+
+	SequentialFile in;
+	EncryptedFileInfo info;
+	if (!OpenEncryptedFile(input_file, in, &info)) {
+		return false;
+	}
+
+	const std::string temp_file = output_file + ".rekey.tmp";
+	std::ofstream out(temp_file, std::ios::binary | std::ios::trunc);
+	if (!out) {
+		return Fail(ProtectorStatus::kFileOpenError, "File open error!");
+	}
+
+	// Legacy inputs do not record the plaintext size; the header is rewritten once the size and the
+	// digest are known.
+	ModelHeader header;
+	header.plaintext_size = info.plaintext_capacity;
+	if (info.chunk_size() != 0) {
+		header.cipher = ModelHeader::kCipherAes256CbcChunked;
+	}
+	if (!ModelHeader::ComputeKeyCheck(new_key.data(), new_iv.data(), header.key_check)) {
+		out.close();
+		std::remove(temp_file.c_str());
+		return Fail(ProtectorStatus::kCipherError, "Failed to compute key check value");
+	}
+	uint8_t header_bytes[ModelHeader::kSize];
+	header.Serialize(header_bytes);
+	out.write(reinterpret_cast<char*>(header_bytes), sizeof(header_bytes));
+
+	ChunkedCbcDecryptor decryptor(kEncryptionKey, kEncryptionIv, info.chunk_size());
+	Xxh3Hasher hasher;
+	ChunkedCbcEncryptor encryptor(new_key.data(), new_iv.data(), info.chunk_size());
+
+	std::vector<uint8_t> chunk(kIoChunkSize + AesCbcDecryptor::kBlockSize);
+	std::vector<uint8_t> cipher_out(kIoChunkSize + 2 * AesCbcDecryptor::kBlockSize);
+	const size_t bulk_size = info.body_size - AesCbcDecryptor::kBlockSize;
+	size_t out_len = 0;
+	ProtectorStatus status = OperationControl::Poll(0, bulk_size);
+
+	for (size_t offset = 0; status == ProtectorStatus::kOk && offset < bulk_size;) {
+		const size_t length = std::min(kIoChunkSize, bulk_size - offset);
+		if (!in.Read(chunk.data(), length)) {
+			status = ProtectorStatus::kIoError;
+		} else if (!decryptor.DecryptBlocks(chunk.data(), chunk.data(),
+											length / AesCbcDecryptor::kBlockSize) ||
+				   !encryptor.Update(chunk.data(), length, cipher_out.data(), &out_len)) {
+			status = ProtectorStatus::kCipherError;
+		} else {
+			hasher.Update(chunk.data(), length);
+			out.write(reinterpret_cast<char*>(cipher_out.data()), out_len);
+		}
+		offset += length;
+		if (status == ProtectorStatus::kOk) {
+			status = OperationControl::Poll(offset, bulk_size);
+		}
+	}
+
+	if (status == ProtectorStatus::kOk) {
+		// Final block: strip the old padding, let the new context add its own.
+		uint8_t last_cipher[AesCbcDecryptor::kBlockSize];
+		size_t tail = 0;
+		if (!in.Read(last_cipher, sizeof(last_cipher))) {
+			status = ProtectorStatus::kIoError;
+		} else if (!DecryptFinalBlock(decryptor.chaining_value(), last_cipher, chunk.data(),
+									  &tail)) {
+			status = ProtectorStatus::kWrongKey;
+		} else if (!encryptor.Update(chunk.data(), tail, cipher_out.data(), &out_len)) {
+			status = ProtectorStatus::kCipherError;
+		} else {
+			hasher.Update(chunk.data(), tail);
+			out.write(reinterpret_cast<char*>(cipher_out.data()), out_len);
+			if (!encryptor.Final(cipher_out.data(), &out_len)) {
+				status = ProtectorStatus::kCipherError;
+			} else {
+				out.write(reinterpret_cast<char*>(cipher_out.data()), out_len);
+			}
+
+			header.plaintext_size = bulk_size + tail;
+			header.flags |= ModelHeader::kFlagContentDigest;
+			header.content_digest = hasher.Digest();
+			header.Serialize(header_bytes);
+			out.seekp(0);
+			out.write(reinterpret_cast<char*>(header_bytes), sizeof(header_bytes));
+			if (status == ProtectorStatus::kOk && info.has_header &&
+				info.header.has_content_digest() &&
+				header.content_digest != info.header.content_digest) {
+				status = ProtectorStatus::kChecksumMismatch;
+			}
+		}
+	}
+
+	OPENSSL_cleanse(chunk.data(), chunk.size());
+	out.close();
+
+	if (status == ProtectorStatus::kOk && !out) {
+		status = ProtectorStatus::kIoError;
+	}
+	if (status != ProtectorStatus::kOk) {
+		std::remove(temp_file.c_str());
+		return Fail(status, "Re-encryption failed for " + input_file);
+	}
+	if (std::rename(temp_file.c_str(), output_file.c_str()) != 0) {
+		std::remove(temp_file.c_str());
+		return Fail(ProtectorStatus::kIoError, "Failed to replace " + output_file);
+	}
+	return true;
+}
+
+/**
+ * @brief Re-encrypts many files in place, several at a time.
+ *
+ * Every file is handled by ReEncrypt() with itself as the output. Files are shared out to
+ * `parallelism` tasks on the protector's executor (see SetExecutor()); each task needs only its
+ * own two chunk buffers. While waiting, the calling thread runs queued tasks itself unless a
+ * policy was set with SetWorkerPolicy(). The calling thread's OperationControl applies to every
+ * task; its progress callback may then be called from several threads at once. Once it is
+ * cancelled or past its deadline, files not yet started are left untouched and count as failed.
+ *
+ * @param files The encrypted files to rotate.
+ * @param new_key The new AES key, kAesKeyLength bytes.
+ * @param new_iv The new AES IV, kAesIvLength bytes.
+ * @param parallelism The number of files re-encrypted at once, 0 for the executor's concurrency.
+ * @return The number of files that failed to re-encrypt.
+ */
+size_t TFLiteModelProtector::ReEncryptFiles(const std::vector<std::string>& files,
+											const std::vector<uint8_t>& new_key,
+											const std::vector<uint8_t>& new_iv,
+											size_t parallelism) {
+	TaskExecutor& executor = Executor();
+	if (parallelism == 0) {
+		parallelism = std::max<size_t>(1, executor.concurrency());
+	}
+	parallelism = std::min(parallelism, files.size());
+
+	const OperationControl* control = OperationControl::Current();
+	std::atomic<size_t> next{0};
+	std::atomic<size_t> failures{0};
+	auto worker = [&]() {
+		ScopedOperationControl scope(control);
+		for (size_t i = next++; i < files.size(); i = next++) {
+			if (OperationControl::Poll() != ProtectorStatus::kOk) {
+				++failures;
+				continue;
+			}
+			try {
+				if (!ReEncrypt(files[i], files[i], new_key, new_iv)) {
+					++failures;
+				}
+			} catch (const std::exception& e) {
+				LOGE("Exception caught: " + std::string(e.what()));
+				++failures;
+			}
+		}
+	};
+
+	TaskGroup group(executor);
+	for (size_t t = 0; t < parallelism; ++t) {
+		group.Run(worker);
+	}
+	group.Wait();
+	return failures;
+}
+
+/**
+ * @brief Writes the chunks of `new_file` that differ from `old_file` to `delta_file`.
+ *
+ * Works on ciphertext alone and needs no key. Both files must be chunked (see
+ * SetChunkedFormat()) and encrypted with the same key and IV, so that unchanged chunks are
+ * byte-identical. The delta records the size and digest of the old plaintext, which
+ * ApplyDelta() and PatchEncryptedFile() check before using it.
+ *
+ * @param old_file The encrypted model the receiver already has.
+ * @param new_file The updated encrypted model.
+ * @param delta_file The delta to write.
+ * @param changed_chunks Receives the number of chunks in the delta, if not null.
+ * @return true on success. On failure `delta_file` is removed.
+ */
+bool TFLiteModelProtector::CreateDelta(const std::string& old_file, const std::string& new_file,
+									   const std::string& delta_file, size_t* changed_chunks) {
+	ScopedTrace trace("CreateDelta", new_file);
+	last_status_ = ProtectorStatus::kOk;
+	SequentialFile old_in;
+	SequentialFile new_in;
+	ModelHeader old_header;
+	ModelHeader new_header;
+	if (!OpenChunkedFile(old_file, old_in, &old_header) ||
+		!OpenChunkedFile(new_file, new_in, &new_header)) {
+		return false;
+	}
+	if (std::memcmp(old_header.key_check, new_header.key_check, sizeof(old_header.key_check)) !=
+		0) {
+		return Fail(ProtectorStatus::kWrongKey,
+					old_file + " and " + new_file + " are encrypted with different keys");
+	}
+	std::ofstream out(delta_file, std::ios::binary | std::ios::trunc);
+	if (!out) {
+		return Fail(ProtectorStatus::kFileOpenError, "File open error: " + delta_file);
+	}
+
+	DeltaHeader delta;
+	delta.base_size = old_header.plaintext_size;
+	delta.base_digest = old_header.content_digest;
+	delta.target = new_header;
+	uint8_t delta_bytes[DeltaHeader::kSize];
+	delta.Serialize(delta_bytes);
+	out.write(reinterpret_cast<char*>(delta_bytes), sizeof(delta_bytes));
+
+	const size_t old_body = ModelHeader::CipherSize(old_header.plaintext_size);
+	const size_t new_body = ModelHeader::CipherSize(new_header.plaintext_size);
+	std::vector<uint8_t> old_chunk(ModelHeader::kChunkSize);
+	std::vector<uint8_t> new_chunk(ModelHeader::kChunkSize);
+	ProtectorStatus status = ProtectorStatus::kOk;
+	for (uint64_t index = 0; status == ProtectorStatus::kOk && index < new_header.chunk_count();
+		 ++index) {
+		const size_t offset = index * ModelHeader::kChunkSize;
+		const size_t length = std::min(ModelHeader::kChunkSize, new_body - offset);
+		const size_t old_length =
+			offset < old_body ? std::min(ModelHeader::kChunkSize, old_body - offset) : 0;
+		if (!new_in.Read(new_chunk.data(), length) ||
+			(old_length > 0 && !old_in.Read(old_chunk.data(), old_length))) {
+			status = ProtectorStatus::kIoError;
+		} else if (old_length != length ||
+				   std::memcmp(old_chunk.data(), new_chunk.data(), length) != 0) {
+			uint8_t index_bytes[DeltaHeader::kIndexSize];
+			DeltaHeader::SerializeIndex(index, index_bytes);
+			out.write(reinterpret_cast<char*>(index_bytes), sizeof(index_bytes));
+			out.write(reinterpret_cast<char*>(new_chunk.data()), length);
+			++delta.chunk_count;
+		}
+	}
+
+	delta.Serialize(delta_bytes);
+	out.seekp(0);
+	out.write(reinterpret_cast<char*>(delta_bytes), sizeof(delta_bytes));
+	out.close();
+	if (status == ProtectorStatus::kOk && !out) {
+		status = ProtectorStatus::kIoError;
+	}
+	if (status != ProtectorStatus::kOk) {
+		std::remove(delta_file.c_str());
+		return Fail(status, "Failed to create delta " + delta_file);
+	}
+	if (changed_chunks != nullptr) {
+		*changed_chunks = static_cast<size_t>(delta.chunk_count);
+	}
+	return true;
+}
+
+/**
+ * @brief Rebuilds the updated encrypted file from the old one and a delta, without the key.
+ *
+ * Unchanged chunks are copied from `old_file` and changed ones from the delta. The output is
+ * written next to `new_file` and renamed into place, so `new_file` may equal `old_file`.
+ *
+ * @return true on success. Fails with kChecksumMismatch if the delta was made for another file.
+ */
+bool TFLiteModelProtector::PatchEncryptedFile(const std::string& old_file,
+											  const std::string& delta_file,
+											  const std::string& new_file) {
+	ScopedTrace trace("PatchEncryptedFile", new_file);
+	last_status_ = ProtectorStatus::kOk;
+	SequentialFile old_in;
+	SequentialFile delta_in;
+	ModelHeader old_header;
+	DeltaHeader delta;
+	if (!OpenChunkedFile(old_file, old_in, &old_header) ||
+		!OpenDelta(delta_file, delta_in, &delta)) {
+		return false;
+	}
+	if (delta.base_size != old_header.plaintext_size ||
+		delta.base_digest != old_header.content_digest ||
+		std::memcmp(delta.target.key_check, old_header.key_check, sizeof(old_header.key_check)) !=
+			0) {
+		return Fail(ProtectorStatus::kChecksumMismatch,
+					"Delta " + delta_file + " does not apply to " + old_file);
+	}
+
+	const std::string temp_file = new_file + ".patch.tmp";
+	std::ofstream out(temp_file, std::ios::binary | std::ios::trunc);
+	if (!out) {
+		return Fail(ProtectorStatus::kFileOpenError, "File open error: " + temp_file);
+	}
+	uint8_t header_bytes[ModelHeader::kSize];
+	delta.target.Serialize(header_bytes);
+	out.write(reinterpret_cast<char*>(header_bytes), sizeof(header_bytes));
+
+	const size_t old_body = ModelHeader::CipherSize(old_header.plaintext_size);
+	const size_t new_body = ModelHeader::CipherSize(delta.target.plaintext_size);
+	std::vector<uint8_t> chunk(ModelHeader::kChunkSize);
+	uint8_t index_bytes[DeltaHeader::kIndexSize];
+	uint64_t records_left = delta.chunk_count;
+	uint64_t next_record = 0;
+	ProtectorStatus status = ProtectorStatus::kOk;
+	if (records_left > 0) {
+		if (delta_in.Read(index_bytes, sizeof(index_bytes))) {
+			next_record = DeltaHeader::ParseIndex(index_bytes);
+		} else {
+			status = ProtectorStatus::kTruncated;
+		}
+	}
+
+	for (uint64_t index = 0;
+		 status == ProtectorStatus::kOk && index < delta.target.chunk_count(); ++index) {
+		const size_t offset = index * ModelHeader::kChunkSize;
+		const size_t length = std::min(ModelHeader::kChunkSize, new_body - offset);
+		if (records_left > 0 && next_record == index) {
+			if (!delta_in.Read(chunk.data(), length)) {
+				status = ProtectorStatus::kTruncated;
+				break;
+			}
+			if (--records_left > 0) {
+				if (!delta_in.Read(index_bytes, sizeof(index_bytes))) {
+					status = ProtectorStatus::kTruncated;
+					break;
+				}
+				next_record = DeltaHeader::ParseIndex(index_bytes);
+				if (next_record <= index) {
+					status = ProtectorStatus::kBadHeader;
+					break;
+				}
+			}
+		} else {
+			// Not in the delta, so the old chunk must be there and have the same length.
+			const size_t old_length =
+				offset < old_body ? std::min(ModelHeader::kChunkSize, old_body - offset) : 0;
+			if (old_length != length) {
+				status = ProtectorStatus::kBadHeader;
+				break;
+			}
+			if (!old_in.Seek(ModelHeader::kSize + offset) || !old_in.Read(chunk.data(), length)) {
+				status = ProtectorStatus::kIoError;
+				break;
+			}
+		}
+		out.write(reinterpret_cast<char*>(chunk.data()), length);
+	}
+	if (status == ProtectorStatus::kOk && records_left > 0) {
+		status = ProtectorStatus::kBadHeader;
+	}
+
+	out.close();
+	if (status == ProtectorStatus::kOk && !out) {
+		status = ProtectorStatus::kIoError;
+	}
+	if (status != ProtectorStatus::kOk) {
+		std::remove(temp_file.c_str());
+		return Fail(status, "Failed to apply delta " + delta_file + " to " + old_file);
+	}
+	if (std::rename(temp_file.c_str(), new_file.c_str()) != 0) {
+		std::remove(temp_file.c_str());
+		return Fail(ProtectorStatus::kIoError, "Failed to replace " + new_file);
+	}
 	return true;
 }
 
@@ -45,42 +552,554 @@ bool TFLiteModelProtector::EncryptFile(const std::string& input_file,
  * @brief Decrypts an encrypted file and loads its contents into memory.
  *
  * This function reads an encrypted file specified by `input_file`, decrypts its contents
- * using AES-256-CBC, and stores the decrypted data in the provided `model_data` vector.
+ * using AES-256-CBC, and appends the decrypted data to the provided `model_data` vector.
+ * The vector grows exactly once, by the plaintext size recorded in the file header.
  *
  * @param input_file The path to the encrypted input file.
  * @param model_data A reference to a vector where the decrypted data will be stored.
+ * @return true on success. On failure LastStatus() tells why and `model_data` is unchanged.
  *
- * @note The function uses a fixed encryption key and initialization vector (IV) defined
+ * @note The function uses the encryption key and initialization vector (IV) defined
  *       by `kEncryptionKey` and `kEncryptionIv` respectively.
- * @note If the file cannot be opened, an error message is logged and the function returns.
  */
-void TFLiteModelProtector::DecryptFileToMemory(const std::string& input_file,
+bool TFLiteModelProtector::DecryptFileToMemory(const std::string& input_file,
 											   std::vector<char>& model_data) {
-	std::ifstream in(input_file, std::ios::binary);
+	return DecryptToVector(input_file, model_data);
+}
+
+/**
+ * @brief Decrypts an encrypted file into a vector backed by a std::pmr::memory_resource.
+ *
+ * Behaves like the std::vector<char> overload; the single allocation comes from the vector's
+ * memory resource, for example a monotonic buffer or a pool owned by the caller.
+ *
+ * @param input_file The path to the encrypted input file.
+ * @param model_data The vector the decrypted data is appended to.
+ * @return true on success. On failure LastStatus() tells why and `model_data` is unchanged.
+ */
+bool TFLiteModelProtector::DecryptFileToMemory(const std::string& input_file,
+											   std::pmr::vector<char>& model_data) {
+	return DecryptToVector(input_file, model_data);
+}
+
+/**
+ * @brief Shared implementation of the vector overloads of DecryptFileToMemory().
+ */
+template <typename Vector>
+bool TFLiteModelProtector::DecryptToVector(const std::string& input_file, Vector& model_data) {
+	ScopedTrace trace("DecryptFileToMemory", input_file);
+	last_status_ = ProtectorStatus::kOk;
+	SequentialFile in;
+	EncryptedFileInfo info;
+	if (!OpenEncryptedFile(input_file, in, &info)) {
+		return false;
+	}
+	return DecryptToVector(input_file, in, info, model_data);
+}
 
-	if (!in) {
-		LOGE("File open error!");
-		return;
+/**
+ * @brief Appends the plaintext of an opened and validated input to `model_data`.
+ *
+ * `input_file` only names the input in log messages.
+ */
+template <typename Vector>
+bool TFLiteModelProtector::DecryptToVector(const std::string& input_file, SequentialFile& in,
+										   const EncryptedFileInfo& info, Vector& model_data) {
+	MemoryGovernor::Reservation reservation;
+	if (!AdmitLoad(input_file, info.plaintext_capacity, &reservation)) {
+		return false;
 	}
 
-	EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
-	EVP_DecryptInit_ex(ctx, EVP_aes_256_cbc(), nullptr, kEncryptionKey, kEncryptionIv);
+	const size_t original_size = model_data.size();
+	model_data.resize(original_size + info.plaintext_capacity);
+	size_t plain_size = 0;
+	if (!DecryptBody(in, info, reinterpret_cast<uint8_t*>(model_data.data() + original_size),
+					 &plain_size)) {
+		OPENSSL_cleanse(model_data.data() + original_size, info.plaintext_capacity);
+		model_data.resize(original_size);
+		return Fail(last_status_, "Decryption failed for " + input_file);
+	}
+	model_data.resize(original_size + plain_size);
+	return true;
+}
+
+/**
+ * @brief Decrypts an encrypted file into memory owned by the caller.
+ *
+ * Use this to decrypt straight into a shared-memory region, an arena or a pinned slab without an
+ * intermediate copy. RequiredBufferSize() tells how large the buffer must be.
+ *
+ * @param input_file The path to the encrypted input file.
+ * @param buffer The destination.
+ * @param capacity The size of `buffer` in bytes.
+ * @param plain_size Receives the number of plaintext bytes written.
+ * @return true on success. On failure LastStatus() tells why (kBufferTooSmall if `capacity` is
+ *         below RequiredBufferSize()) and any partially decrypted data has been wiped.
+ */
+bool TFLiteModelProtector::DecryptFileToMemory(const std::string& input_file, void* buffer,
+											   size_t capacity, size_t* plain_size) {
+	ScopedTrace trace("DecryptFileToMemory", input_file);
+	last_status_ = ProtectorStatus::kOk;
+	SequentialFile in;
+	EncryptedFileInfo info;
+	if (!OpenEncryptedFile(input_file, in, &info)) {
+		return false;
+	}
+	if (capacity < info.plaintext_capacity) {
+		return Fail(ProtectorStatus::kBufferTooSmall, "Buffer of " + std::to_string(capacity) +
+														  " bytes is too small for " + input_file);
+	}
+	if (!DecryptBody(in, info, static_cast<uint8_t*>(buffer), plain_size)) {
+		OPENSSL_cleanse(buffer, info.plaintext_capacity);
+		return Fail(last_status_, "Decryption failed for " + input_file);
+	}
+	return true;
+}
+
+/**
+ * @brief Returns the buffer size DecryptFileToMemory() needs for a file, reading only its header.
+ *
+ * For files with a header this is the exact plaintext size. Legacy files do not record it, so
+ * the ciphertext size is returned as an upper bound.
+ *
+ * @param input_file The path to the encrypted input file.
+ * @param size Receives the required size in bytes.
+ * @return false if the file cannot be opened or fails validation (see LastStatus()).
+ */
+bool TFLiteModelProtector::RequiredBufferSize(const std::string& input_file, size_t* size) {
+	last_status_ = ProtectorStatus::kOk;
+	SequentialFile in;
+	EncryptedFileInfo info;
+	if (!OpenEncryptedFile(input_file, in, &info)) {
+		return false;
+	}
+	*size = info.plaintext_capacity;
+	return true;
+}
+
+/**
+ * @brief Decrypts an encrypted file straight into a preallocated model buffer.
+ *
+ * The buffer is allocated once, using the policy set by SetBufferPolicy(), with the plaintext
+ * size from the file header as capacity. Decrypted chunks are written in place, so no
+ * intermediate vector growth or copy takes place.
+ *
+ * @param input_file The path to the encrypted input file.
+ * @param model_buffer The buffer that receives the decrypted data. Previous contents are released.
+ * @return true if the file was decrypted successfully, false otherwise (see LastStatus()).
+ *
+ * @note If a NUMA node was set with SetNumaNode(), decryption and allocation are bound to it.
+ */
+bool TFLiteModelProtector::DecryptFileToMemory(const std::string& input_file,
+											   ModelBuffer& model_buffer) {
+	ScopedTrace trace("DecryptFileToMemory", input_file);
+	last_status_ = ProtectorStatus::kOk;
+	return DecryptToBuffer(input_file, model_buffer, numa_node_);
+}
+
+/**
+ * @brief Shared implementation of DecryptFileToMemory() for an explicit NUMA node.
+ *
+ * When `numa_node` is set, both the allocation and the decryption run on that node, so the
+ * plaintext is first touched by a local CPU. `digest`, if given, receives the plaintext XXH3.
+ */
+bool TFLiteModelProtector::DecryptToBuffer(const std::string& input_file,
+										   ModelBuffer& model_buffer, int numa_node,
+										   uint64_t* digest) {
+	ScopedNodeAffinity affinity(numa_node);
+	SequentialFile in;
+	EncryptedFileInfo info;
+	MemoryGovernor::Reservation reservation;
+	if (!OpenEncryptedFile(input_file, in, &info) ||
+		!AdmitLoad(input_file, info.plaintext_capacity, &reservation)) {
+		return false;
+	}
+	return DecryptToBuffer(input_file, in, info, model_buffer, numa_node, digest);
+}
+
+/**
+ * @brief Decrypts an opened and validated input into `model_buffer`.
+ *
+ * The caller sets affinity and has already admitted the load with AdmitLoad(), holding the
+ * reservation until this returns. `input_file` only names the input in log messages.
+ */
+bool TFLiteModelProtector::DecryptToBuffer(const std::string& input_file, SequentialFile& in,
+										   const EncryptedFileInfo& info, ModelBuffer& model_buffer,
+										   int numa_node, uint64_t* digest) {
+	{
+		ScopedTrace trace("allocate");
+		if (!model_buffer.Allocate(info.plaintext_capacity, buffer_policy_, prefault_buffer_,
+								   numa_node)) {
+			return Fail(ProtectorStatus::kAllocationError, "Failed to allocate model buffer");
+		}
+	}
+
+	size_t plain_size = 0;
+	const bool ok =
+		DecryptBody(in, info, reinterpret_cast<uint8_t*>(model_buffer.data()), &plain_size, digest);
+	model_buffer.Resize(ok ? plain_size : 0);
+	if (!ok) {
+		return Fail(last_status_, "Decryption failed for " + input_file);
+	}
+	return true;
+}
+
+/**
+ * @brief Decrypts an encrypted model held in memory, for example received over IPC or embedded
+ * in the binary, and appends the plaintext to `model_data`.
+ *
+ * The ciphertext is validated exactly like a file and decrypted from where it lies, so it is
+ * neither copied nor written to disk.
+ *
+ * @param ciphertext The encrypted model, with or without a ModelHeader.
+ * @param size The size of `ciphertext` in bytes.
+ * @param model_data The vector the decrypted data is appended to.
+ * @return true on success. On failure LastStatus() tells why and `model_data` is unchanged.
+ */
+bool TFLiteModelProtector::DecryptBufferToMemory(const void* ciphertext, size_t size,
+												 std::vector<char>& model_data) {
+	ScopedTrace trace("DecryptBufferToMemory");
+	last_status_ = ProtectorStatus::kOk;
+	SequentialFile in;
+	EncryptedFileInfo info;
+	if (!OpenEncryptedBuffer(ciphertext, size, in, &info)) {
+		return false;
+	}
+	return DecryptToVector(kBufferName, in, info, model_data);
+}
+
+/**
+ * @brief Decrypts an encrypted model held in memory into a preallocated model buffer.
+ *
+ * Like the file overload of DecryptFileToMemory(), the buffer is allocated once with the policy
+ * set by SetBufferPolicy() and on the node set by SetNumaNode().
+ *
+ * @param ciphertext The encrypted model, with or without a ModelHeader.
+ * @param size The size of `ciphertext` in bytes.
+ * @param model_buffer The buffer that receives the decrypted data. Previous contents are released.
+ * @return true on success, false otherwise (see LastStatus()).
+ */
+bool TFLiteModelProtector::DecryptBufferToMemory(const void* ciphertext, size_t size,
+												 ModelBuffer& model_buffer) {
+	ScopedTrace trace("DecryptBufferToMemory");
+	last_status_ = ProtectorStatus::kOk;
+	ScopedNodeAffinity affinity(numa_node_);
+	SequentialFile in;
+	EncryptedFileInfo info;
+	MemoryGovernor::Reservation reservation;
+	if (!OpenEncryptedBuffer(ciphertext, size, in, &info) ||
+		!AdmitLoad(kBufferName, info.plaintext_capacity, &reservation)) {
+		return false;
+	}
+	return DecryptToBuffer(kBufferName, in, info, model_buffer, numa_node_);
+}
+
+/**
+ * @brief Decrypts an encrypted model in place, in a writable buffer owned by the caller.
+ *
+ * Nothing is allocated: each ciphertext block is overwritten by its plaintext. The plaintext
+ * starts right after the header (at `buffer` for legacy files), so it keeps the buffer's
+ * alignment as long as the buffer is 32-byte aligned. The ciphertext is destroyed either way.
+ *
+ * @param buffer The encrypted model. Receives the plaintext.
+ * @param size The size of `buffer` in bytes.
+ * @param model_data Receives a pointer to the plaintext inside `buffer`.
+ * @param model_size Receives the plaintext size in bytes.
+ * @return true on success. On failure LastStatus() tells why and the decrypted part has been
+ *         wiped.
+ */
+bool TFLiteModelProtector::DecryptBufferInPlace(void* buffer, size_t size, char** model_data,
+												size_t* model_size) {
+	ScopedTrace trace("DecryptBufferInPlace");
+	last_status_ = ProtectorStatus::kOk;
+	SequentialFile in;
+	EncryptedFileInfo info;
+	if (!OpenEncryptedBuffer(buffer, size, in, &info)) {
+		return false;
+	}
+	uint8_t* plain = static_cast<uint8_t*>(buffer) + in.offset();
+	if (!DecryptBody(in, info, plain, model_size)) {
+		OPENSSL_cleanse(plain, info.body_size);
+		return Fail(last_status_, "Decryption failed for " + kBufferName);
+	}
+	*model_data = reinterpret_cast<char*>(plain);
+	return true;
+}
+
+/**
+ * @brief Asks the memory governor, if one is set, for room to decrypt `bytes` of plaintext.
+ *
+ * Hold `reservation` until the buffer has been filled; by then the cgroup counts the memory.
+ */
+bool TFLiteModelProtector::AdmitLoad(const std::string& input_file, size_t bytes,
+									 MemoryGovernor::Reservation* reservation) {
+	const ProtectorStatus control = OperationControl::Poll();
+	if (control != ProtectorStatus::kOk) {
+		return Fail(control, "Load of " + input_file + " abandoned");
+	}
+	if (!memory_governor_) {
+		return true;
+	}
+	ScopedTrace trace("admit", input_file);
+	*reservation = memory_governor_->Admit(bytes);
+	if (!*reservation) {
+		const ProtectorStatus status = OperationControl::Poll();
+		return Fail(status != ProtectorStatus::kOk ? status : ProtectorStatus::kMemoryPressure,
+					"Not enough memory to load " + input_file + ", load rejected");
+	}
+	return true;
+}
+
+/**
+ * @brief Opens a chunked encrypted file for delta work and reads its header. Needs no key.
+ *
+ * On success `in` is positioned at the first ciphertext byte.
+ */
+bool TFLiteModelProtector::OpenChunkedFile(const std::string& path, SequentialFile& in,
+										   ModelHeader* header) {
+	if (!in.Open(path)) {
+		return Fail(ProtectorStatus::kFileOpenError, "File open error: " + path);
+	}
+	uint8_t header_bytes[ModelHeader::kSize];
+	if (in.size() < ModelHeader::kSize || !in.Read(header_bytes, sizeof(header_bytes)) ||
+		!ModelHeader::Parse(header_bytes, sizeof(header_bytes), header) ||
+		!header->is_chunked() || !header->has_content_digest()) {
+		return Fail(ProtectorStatus::kBadHeader, "Not a chunked encrypted model: " + path);
+	}
+	if (in.size() - ModelHeader::kSize != ModelHeader::CipherSize(header->plaintext_size)) {
+		return Fail(ProtectorStatus::kTruncated, "Truncated or corrupt encrypted file: " + path);
+	}
+	return true;
+}
+
+/**
+ * @brief Opens a delta file and reads its header. On success `in` is at the first record.
+ */
+bool TFLiteModelProtector::OpenDelta(const std::string& path, SequentialFile& in,
+									 DeltaHeader* delta) {
+	if (!in.Open(path)) {
+		return Fail(ProtectorStatus::kFileOpenError, "File open error: " + path);
+	}
+	uint8_t delta_bytes[DeltaHeader::kSize];
+	if (in.size() < DeltaHeader::kSize || !in.Read(delta_bytes, sizeof(delta_bytes)) ||
+		!DeltaHeader::Parse(delta_bytes, sizeof(delta_bytes), delta)) {
+		return Fail(ProtectorStatus::kBadHeader, "Not a model delta: " + path);
+	}
+	return true;
+}
+
+/**
+ * @brief Opens an encrypted file and validates it before any of the body is read.
+ *
+ * For files with a ModelHeader the key check value and the exact body size are checked, so a
+ * wrong key or a truncated file fails after reading 32 bytes. Legacy bare CBC files only get
+ * the block size check. On success `in` is positioned at the first ciphertext byte.
+ */
+bool TFLiteModelProtector::OpenEncryptedFile(const std::string& path, SequentialFile& in,
+											 EncryptedFileInfo* info) {
+	ScopedTrace trace("open");
+	if (!in.Open(path)) {
+		return Fail(ProtectorStatus::kFileOpenError, "File open error: " + path);
+	}
+	return ValidateEncryptedInput(path, in, info);
+}
+
+/**
+ * @brief Validates encrypted data held in memory, like OpenEncryptedFile() does for a file.
+ *
+ * `in` reads straight from `data`, which must stay valid until decryption has finished.
+ */
+bool TFLiteModelProtector::OpenEncryptedBuffer(const void* data, size_t size, SequentialFile& in,
+											   EncryptedFileInfo* info) {
+	ScopedTrace trace("open");
+	if (data == nullptr && size != 0) {
+		return Fail(ProtectorStatus::kIoError, "Null encrypted buffer");
+	}
+	in.OpenMemory(data, size);
+	return ValidateEncryptedInput(kBufferName, in, info);
+}
+
+/**
+ * @brief Reads and checks the header of an opened input. `path` names it in log messages.
+ */
+bool TFLiteModelProtector::ValidateEncryptedInput(const std::string& path, SequentialFile& in,
+												  EncryptedFileInfo* info) {
+	const size_t file_size = in.size();
+	uint8_t header_bytes[ModelHeader::kSize] = {};
+	const size_t header_read = std::min(file_size, ModelHeader::kSize);
+	if (!in.Read(header_bytes, header_read)) {
+		return Fail(ProtectorStatus::kIoError, "Read error: " + path);
+	}
 
-	std::vector<uint8_t> buffer(4096);
-	std::vector<uint8_t> plain_buffer(4096 + EVP_MAX_BLOCK_LENGTH);
-	int out_len = 0;
+	info->has_header = ModelHeader::HasMagic(header_bytes, header_read);
+	if (!info->has_header) {
+		in.Seek(0);
+		info->body_size = file_size;
+		info->plaintext_capacity = file_size;
+		if (file_size == 0 || file_size % AesCbcDecryptor::kBlockSize != 0) {
+			return Fail(ProtectorStatus::kTruncated,
+						"Truncated or corrupt encrypted file: " + path);
+		}
+		return true;
+	}
 
-	while (in.read(reinterpret_cast<char*>(buffer.data()), buffer.size()) || in.gcount()) {
-		EVP_DecryptUpdate(ctx, plain_buffer.data(), &out_len, buffer.data(), in.gcount());
-		model_data.insert(model_data.end(), plain_buffer.begin(), plain_buffer.begin() + out_len);
+	if (!ModelHeader::Parse(header_bytes, header_read, &info->header)) {
+		return Fail(ProtectorStatus::kBadHeader, "Unsupported encrypted model header: " + path);
+	}
+	uint8_t key_check[ModelHeader::kKeyCheckLength];
+	if (!ModelHeader::ComputeKeyCheck(kEncryptionKey, kEncryptionIv, key_check) ||
+		CRYPTO_memcmp(key_check, info->header.key_check, sizeof(key_check)) != 0) {
+		return Fail(ProtectorStatus::kWrongKey, "Wrong key or IV for " + path);
 	}
+	info->body_size = file_size - ModelHeader::kSize;
+	info->plaintext_capacity = static_cast<size_t>(info->header.plaintext_size);
+	if (info->body_size != ModelHeader::CipherSize(info->header.plaintext_size)) {
+		return Fail(ProtectorStatus::kTruncated, "Truncated or corrupt encrypted file: " + path);
+	}
+	return true;
+}
+
+/**
+ * @brief Decrypts the body of an input opened by OpenEncryptedFile() or OpenEncryptedBuffer().
+ *
+ * File ciphertext is read straight into `out` and decrypted in place, chunk by chunk, while it is
+ * still in cache; ciphertext in memory is decrypted from where it lies, which may be `out` itself.
+ * The last block carries the padding and is handled by DecryptFinalBlock().
+ * If the header carries a content digest, or the caller asks for `digest`, each chunk is hashed
+ * right after it is decrypted, while it is still in L2; a header digest is compared at the end.
+ * Unless disabled with SetDropPageCache(), ciphertext pages are dropped from the page cache as
+ * decryption moves past them. `out` must hold info.plaintext_capacity bytes.
+ */
+bool TFLiteModelProtector::DecryptBody(SequentialFile& in, const EncryptedFileInfo& info,
+									   uint8_t* out, size_t* plain_size, uint64_t* digest) {
+	const auto start = std::chrono::steady_clock::now();
+	ChunkedCbcDecryptor decryptor(kEncryptionKey, kEncryptionIv, info.chunk_size());
+	const size_t bulk_size = info.body_size - AesCbcDecryptor::kBlockSize;
+	const bool check_digest = info.has_header && info.header.has_content_digest();
+	const bool hash = check_digest || digest != nullptr;
+	Xxh3Hasher hasher;
+	ProtectorStatus control = OperationControl::Poll(0, bulk_size);
 
-	EVP_DecryptFinal_ex(ctx, plain_buffer.data(), &out_len);
+	for (size_t offset = 0; control == ProtectorStatus::kOk && offset < bulk_size;) {
+		const size_t length = std::min(kIoChunkSize, bulk_size - offset);
+		const uint8_t* cipher = nullptr;
+		{
+			ScopedTrace trace("read");
+			cipher = in.Next(out + offset, length);
+			if (cipher == nullptr) {
+				last_status_ = ProtectorStatus::kIoError;
+				return false;
+			}
+		}
+		{
+			ScopedTrace trace("decrypt");
+			if (!decryptor.DecryptBlocks(cipher, out + offset,
+										 length / AesCbcDecryptor::kBlockSize)) {
+				last_status_ = ProtectorStatus::kCipherError;
+				return false;
+			}
+		}
+		if (hash) {
+			ScopedTrace trace("checksum");
+			hasher.Update(out + offset, length);
+		}
+		offset += length;
+		if (drop_page_cache_ && offset % kPageCacheDropInterval == 0) {
+			in.DropConsumed();
+		}
+		control = OperationControl::Poll(offset, bulk_size);
+	}
+	if (control != ProtectorStatus::kOk) {
+		last_status_ = control;
+		return false;
+	}
 
+	ScopedTrace trace("finalize");
+	uint8_t last_cipher[AesCbcDecryptor::kBlockSize];
+	uint8_t last_plain[AesCbcDecryptor::kBlockSize];
+	size_t tail = 0;
+	if (!in.Read(last_cipher, sizeof(last_cipher))) {
+		last_status_ = ProtectorStatus::kIoError;
+		return false;
+	}
+	if (drop_page_cache_) {
+		in.DropConsumed();
+	}
+	const bool ok = DecryptFinalBlock(decryptor.chaining_value(), last_cipher, last_plain, &tail) &&
+					bulk_size + tail <= info.plaintext_capacity &&
+					(!info.has_header || bulk_size + tail == info.header.plaintext_size);
+	if (ok) {
+		std::memcpy(out + bulk_size, last_plain, tail);
+	}
+	OPENSSL_cleanse(last_plain, sizeof(last_plain));
+	if (!ok) {
+		last_status_ = ProtectorStatus::kWrongKey;
+		return false;
+	}
+	if (hash) {
+		hasher.Update(out + bulk_size, tail);
+		const uint64_t content_digest = hasher.Digest();
+		if (check_digest && content_digest != info.header.content_digest) {
+			last_status_ = ProtectorStatus::kChecksumMismatch;
+			return false;
+		}
+		if (digest != nullptr) {
+			*digest = content_digest;
+		}
+	}
+	*plain_size = bulk_size + tail;
+	ProtectorMetrics::Instance().RecordDecrypt(*plain_size,
+											   std::chrono::steady_clock::now() - start);
+	return true;
+}
+
+/**
+ * @brief Decrypts the final, padded cipher block and strips the PKCS#7 padding.
+ *
+ * @param chaining_value The ciphertext block preceding `last_cipher` (or the IV).
+ * @param last_cipher The final cipher block.
+ * @param plain Receives up to kBlockSize - 1 plaintext bytes.
+ * @param length Receives the number of plaintext bytes.
+ * @return false if the padding is invalid, which usually means a wrong key.
+ */
+bool TFLiteModelProtector::DecryptFinalBlock(const uint8_t* chaining_value,
+											 const uint8_t* last_cipher, uint8_t* plain,
+											 size_t* length) {
+	EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+	uint8_t block[2 * AesCbcDecryptor::kBlockSize];
+	int update_len = 0;
+	int final_len = 0;
+	const bool ok =
+		EVP_DecryptInit_ex(ctx, EVP_aes_256_cbc(), nullptr, kEncryptionKey, chaining_value) == 1 &&
+		EVP_DecryptUpdate(ctx, block, &update_len, last_cipher, AesCbcDecryptor::kBlockSize) == 1 &&
+		EVP_DecryptFinal_ex(ctx, block + update_len, &final_len) == 1;
 	EVP_CIPHER_CTX_free(ctx);
-	in.close();
+
+	if (ok) {
+		*length = static_cast<size_t>(update_len + final_len);
+		std::memcpy(plain, block, *length);
+	}
+	OPENSSL_cleanse(block, sizeof(block));
+	return ok;
 }
 
+/**
+ * @brief Records `status` as the calling thread's last status, counts it and logs `message`.
+ *
+ * @return Always false, so failure paths can `return Fail(...)`.
+ */
+bool TFLiteModelProtector::Fail(ProtectorStatus status, const std::string& message) {
+	last_status_ = status;
+	ProtectorMetrics::Instance().RecordFailure(status);
+	LOGE(message + " (" + ProtectorStatusName(status) + ")");
+	return false;
+}
+
+/**
+ * @brief Returns the status of the last protector operation on the calling thread.
+ */
+ProtectorStatus TFLiteModelProtector::LastStatus() { return last_status_; }
+
 /**
  * @brief Loads a TensorFlow Lite model from the provided model data.
  *
@@ -92,28 +1111,706 @@ void TFLiteModelProtector::DecryptFileToMemory(const std::string& input_file,
  */
 std::unique_ptr<tflite::FlatBufferModel> TFLiteModelProtector::LoadModel(
 	const std::vector<char>& model_data) {
+	ScopedTrace trace("BuildFromBuffer");
+	return tflite::FlatBufferModel::BuildFromBuffer(model_data.data(), model_data.size());
+}
+
+/**
+ * @brief Loads a TensorFlow Lite model from a decrypted model buffer.
+ *
+ * @param model_data The buffer holding the decrypted model. It must outlive the returned model.
+ * @return A unique pointer to the loaded TensorFlow Lite FlatBufferModel.
+ */
+std::unique_ptr<tflite::FlatBufferModel> TFLiteModelProtector::LoadModel(
+	const ModelBuffer& model_data) {
+	ScopedTrace trace("BuildFromBuffer");
 	return tflite::FlatBufferModel::BuildFromBuffer(model_data.data(), model_data.size());
 }
 
+/**
+ * @brief Loads a TensorFlow Lite model from decrypted data in caller-owned memory.
+ *
+ * @param model_data The decrypted model. It must outlive the returned model.
+ * @param size The model size in bytes.
+ * @return A unique pointer to the loaded TensorFlow Lite FlatBufferModel.
+ */
+std::unique_ptr<tflite::FlatBufferModel> TFLiteModelProtector::LoadModel(const void* model_data,
+																		 size_t size) {
+	ScopedTrace trace("BuildFromBuffer");
+	return tflite::FlatBufferModel::BuildFromBuffer(static_cast<const char*>(model_data), size);
+}
+
 /**
  * @brief Loads an encrypted TensorFlow Lite model from the specified file path.
  *
  * This function decrypts the model file into memory and then loads the model
  * from the decrypted data. It uses a mutex to ensure thread safety.
  *
+ * The plaintext is kept in this protector's model buffer, so the returned model is valid until
+ * the next successful LoadEncryptedModel(), LoadEncryptedModelFromBuffer() or LoadEmbeddedModel()
+ * on this protector, and no longer than the protector. A failed load leaves the previous model
+ * intact. Use LoadDecryptedModel() for models that must outlive either.
+ *
  * @param model_path The file path to the encrypted model.
  * @return A unique pointer to the loaded TensorFlow Lite model, or nullptr if an exception occurs.
  */
 std::unique_ptr<tflite::FlatBufferModel> TFLiteModelProtector::LoadEncryptedModel(
 	const std::string& model_path) {
-	std::lock_guard<std::mutex> lock(mutex_);
+	ScopedTrace trace("LoadEncryptedModel", model_path);
+	last_status_ = ProtectorStatus::kOk;
+	ProtectorMetrics::Instance().RecordLoad();
+	try {
+		SequentialFile in;
+		EncryptedFileInfo info;
+		if (!OpenEncryptedFile(model_path, in, &info)) {
+			return nullptr;
+		}
+		return LoadToModelBuffer(model_path, in, info);
+	} catch (const std::exception& e) {
+		LOGE("Exception caught: " + std::string(e.what()));
+		return nullptr;
+	}
+}
+
+/**
+ * @brief Loads an encrypted TensorFlow Lite model held in memory.
+ *
+ * Like LoadEncryptedModel(), the plaintext goes to this protector's model buffer, so the
+ * returned model is valid until the next successful load on this protector. The ciphertext can
+ * be released as soon as this returns.
+ *
+ * @param ciphertext The encrypted model, with or without a ModelHeader.
+ * @param size The size of `ciphertext` in bytes.
+ * @return The loaded model, or nullptr on failure (see LastStatus()).
+ */
+std::unique_ptr<tflite::FlatBufferModel> TFLiteModelProtector::LoadEncryptedModelFromBuffer(
+	const void* ciphertext, size_t size) {
+	ScopedTrace trace("LoadEncryptedModelFromBuffer");
+	last_status_ = ProtectorStatus::kOk;
+	ProtectorMetrics::Instance().RecordLoad();
+	try {
+		SequentialFile in;
+		EncryptedFileInfo info;
+		if (!OpenEncryptedBuffer(ciphertext, size, in, &info)) {
+			return nullptr;
+		}
+		return LoadToModelBuffer(kBufferName, in, info);
+	} catch (const std::exception& e) {
+		LOGE("Exception caught: " + std::string(e.what()));
+		return nullptr;
+	}
+}
+
+/**
+ * @brief Decrypts an opened and validated input, builds the model and, if that succeeds, makes
+ * the plaintext this protector's model buffer.
+ *
+ * The load is admitted by the memory governor before the load lock is taken, so a deferred
+ * admission never holds up other protectors' loads; only the decryption and the buffer swap run
+ * under the lock. The previous buffer, which backs the model of the previous load, is released
+ * only once the new model is built, so a load that fails on a wrong key, a truncated file or a
+ * bad model never pulls the memory from under a model that is still in use.
+ *
+ * `input_file` only names the input in log messages.
+ */
+std::unique_ptr<tflite::FlatBufferModel> TFLiteModelProtector::LoadToModelBuffer(
+	const std::string& input_file, SequentialFile& in, const EncryptedFileInfo& info) {
+	MemoryGovernor::Reservation reservation;
+	if (!AdmitLoad(input_file, info.plaintext_capacity, &reservation)) {
+		return nullptr;
+	}
+	std::unique_lock<std::timed_mutex> lock = LockForLoad(input_file);
+	if (!lock.owns_lock()) {
+		return nullptr;
+	}
+	ModelBuffer model_buffer;
+	{
+		ScopedNodeAffinity affinity(numa_node_);
+		if (!DecryptToBuffer(input_file, in, info, model_buffer, numa_node_)) {
+			return nullptr;
+		}
+	}
+	std::unique_ptr<tflite::FlatBufferModel> model = LoadModel(model_buffer);
+	if (model) {
+		model_buffer_ = std::move(model_buffer);
+	}
+	return model;
+}
+
+/**
+ * @brief Decrypts an encrypted model in the caller's writable buffer and loads it from there.
+ *
+ * See DecryptBufferInPlace(). The returned model points into `buffer`, which must outlive it;
+ * this protector's model buffer is left alone, so no lock is taken.
+ *
+ * @param buffer The encrypted model. Receives the plaintext.
+ * @param size The size of `buffer` in bytes.
+ * @return The loaded model, or nullptr on failure (see LastStatus()).
+ */
+std::unique_ptr<tflite::FlatBufferModel> TFLiteModelProtector::LoadEncryptedModelInPlace(
+	void* buffer, size_t size) {
+	ScopedTrace trace("LoadEncryptedModelInPlace");
+	char* model_data = nullptr;
+	size_t model_size = 0;
+	if (!DecryptBufferInPlace(buffer, size, &model_data, &model_size)) {
+		return nullptr;
+	}
+	return LoadModel(model_data, model_size);
+}
+
+/**
+ * @brief Loads an encrypted model linked into the executable by tflite_protect_embed().
+ *
+ * No file is opened: the ciphertext is decrypted straight from the executable's read-only
+ * mapping, which is advised for sequential access first so page faults read ahead. Like
+ * LoadEncryptedModel(), the plaintext goes to this protector's model buffer.
+ *
+ * @param embedded The embedded ciphertext, usually TFLITE_EMBEDDED_MODEL(name).
+ * @return The loaded model, or nullptr on failure (see LastStatus()).
+ */
+std::unique_ptr<tflite::FlatBufferModel> TFLiteModelProtector::LoadEmbeddedModel(
+	const EmbeddedModel& embedded) {
+	ScopedTrace trace("LoadEmbeddedModel");
+	const uintptr_t page_size = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+	const uintptr_t begin = reinterpret_cast<uintptr_t>(embedded.data) & ~(page_size - 1);
+	const uintptr_t end = reinterpret_cast<uintptr_t>(embedded.data) + embedded.size;
+	if (embedded.data != nullptr && end > begin) {
+		madvise(reinterpret_cast<void*>(begin), end - begin, MADV_SEQUENTIAL);
+	}
+	return LoadEncryptedModelFromBuffer(embedded.data, embedded.size);
+}
+
+/**
+ * @brief Loads an encrypted model once per NUMA node.
+ *
+ * The file is decrypted a single time on the first node of NumaTopology::ReplicaNodes() and the
+ * plaintext is then copied to a buffer bound to every other such node, by a thread running on
+ * that node. A node the thread cannot be pinned to gets no replica; its threads use the primary
+ * one. Inference threads should call NumaReplicatedModel::Local() to get the replica next to them.
+ *
+ * @param model_path The file path to the encrypted model.
+ * @return The replicated model, or nullptr if decryption or any replica failed (see
+ *         LastStatus()).
+ */
+std::shared_ptr<NumaReplicatedModel> TFLiteModelProtector::LoadEncryptedModelReplicated(
+	const std::string& model_path) {
+	ScopedTrace trace("LoadEncryptedModelReplicated", model_path);
+	last_status_ = ProtectorStatus::kOk;
+	ProtectorMetrics::Instance().RecordLoad();
+	try {
+		// Admitted before the lock, like LoadToModelBuffer().
+		SequentialFile in;
+		EncryptedFileInfo info;
+		MemoryGovernor::Reservation reservation;
+		if (!OpenEncryptedFile(model_path, in, &info) ||
+			!AdmitLoad(model_path, info.plaintext_capacity, &reservation)) {
+			return nullptr;
+		}
+		std::unique_lock<std::timed_mutex> lock = LockForLoad(model_path);
+		if (!lock.owns_lock()) {
+			return nullptr;
+		}
+		const std::vector<int> nodes = NumaTopology::ReplicaNodes();
+		const int primary = nodes.front();
+		auto replicated = std::make_shared<NumaReplicatedModel>();
+		replicated->buffers_.resize(nodes.back() + 1);
+		replicated->models_.resize(nodes.back() + 1);
+		replicated->primary_node_ = primary;
+
+		{
+			const int decrypt_node = nodes.size() > 1 ? primary : -1;
+			ScopedNodeAffinity affinity(decrypt_node);
+			if (!DecryptToBuffer(model_path, in, info, replicated->buffers_[primary],
+								 decrypt_node)) {
+				return nullptr;
+			}
+		}
+		const ModelBuffer& source = replicated->buffers_[primary];
+		std::vector<int> placed = {primary};
+		for (size_t i = 1; i < nodes.size(); ++i) {
+			const int node = nodes[i];
+			ScopedTrace replicate_trace("replicate");
+			ScopedNodeAffinity affinity(node);
+			if (!affinity.active()) {
+				LOGE("Cannot run on NUMA node " + std::to_string(node) +
+					 ", no replica placed there");
+				continue;
+			}
+			ModelBuffer& replica = replicated->buffers_[node];
+			if (!replica.Allocate(source.size(), buffer_policy_, false, node)) {
+				Fail(ProtectorStatus::kAllocationError,
+					 "Failed to allocate the replica on NUMA node " + std::to_string(node));
+				return nullptr;
+			}
+			std::memcpy(replica.data(), source.data(), source.size());
+			replica.Resize(source.size());
+			placed.push_back(node);
+		}
+
+		for (const int node : placed) {
+			replicated->models_[node] = LoadModel(replicated->buffers_[node]);
+			if (!replicated->models_[node]) {
+				Fail(ProtectorStatus::kInvalidModel, "Not a valid TFLite model: " + model_path);
+				return nullptr;
+			}
+		}
+		return replicated;
+	} catch (const std::exception& e) {
+		LOGE("Exception caught: " + std::string(e.what()));
+		return nullptr;
+	}
+}
+
+/**
+ * @brief Decrypts and loads a model into a self-contained, move-only DecryptedModel.
+ *
+ * Unlike LoadEncryptedModel(), every call gets its own buffer (allocated with the policy from
+ * SetBufferPolicy()), so loads do not take the protector lock and the result can outlive this
+ * protector. Nothing is copied after decryption.
+ *
+ * @param model_path The file path to the encrypted model.
+ * @return The loaded model, or an empty DecryptedModel on failure (see LastStatus()).
+ */
+DecryptedModel TFLiteModelProtector::LoadDecryptedModel(const std::string& model_path) {
+	ScopedTrace trace("LoadDecryptedModel", model_path);
+	last_status_ = ProtectorStatus::kOk;
+	ProtectorMetrics::Instance().RecordLoad();
+	DecryptedModel result;
+	try {
+		const auto start = std::chrono::steady_clock::now();
+		if (!DecryptToBuffer(model_path, result.buffer_, numa_node_, &result.content_digest_)) {
+			return DecryptedModel();
+		}
+		const auto decrypted = std::chrono::steady_clock::now();
+		result.model_ = LoadModel(result.buffer_);
+		if (!result.model_) {
+			Fail(ProtectorStatus::kInvalidModel, "Not a valid TFLite model: " + model_path);
+			return DecryptedModel();
+		}
+		using std::chrono::duration_cast;
+		result.timings_.decrypt = duration_cast<std::chrono::nanoseconds>(decrypted - start);
+		result.timings_.build =
+			duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - decrypted);
+		result.source_ = model_path;
+		return result;
+	} catch (const std::exception& e) {
+		LOGE("Exception caught: " + std::string(e.what()));
+		return DecryptedModel();
+	}
+}
+
+/**
+ * @brief Builds the updated model from a loaded one and a delta, decrypting only the changed
+ * chunks.
+ *
+ * The plaintext of `base` is copied into a new buffer and the chunks in the delta are decrypted
+ * over it, so disk reads and decryption scale with the size of the change. The result is then
+ * checked against the target file's content digest. Hashing runs at memory speed, far faster
+ * than decryption. `base` is left untouched and can keep serving until the new model replaces
+ * it.
+ *
+ * @param base A model loaded from the file the delta was made against. It needs its content
+ *        digest, which LoadDecryptedModel() and LoadSharedModel() always record.
+ * @param delta_file A delta written by CreateDelta().
+ * @return The updated model, or an empty DecryptedModel on failure (see LastStatus()).
+ */
+DecryptedModel TFLiteModelProtector::ApplyDelta(const DecryptedModel& base,
+												const std::string& delta_file) {
+	ScopedTrace trace("ApplyDelta", delta_file);
+	last_status_ = ProtectorStatus::kOk;
+	ProtectorMetrics::Instance().RecordLoad();
 	try {
-		DecryptFileToMemory(model_path, model_buffer_);
-		return LoadModel(model_buffer_);
+		const auto start = std::chrono::steady_clock::now();
+		SequentialFile in;
+		DeltaHeader delta;
+		if (!OpenDelta(delta_file, in, &delta)) {
+			return DecryptedModel();
+		}
+		uint8_t key_check[ModelHeader::kKeyCheckLength];
+		if (!ModelHeader::ComputeKeyCheck(kEncryptionKey, kEncryptionIv, key_check) ||
+			CRYPTO_memcmp(key_check, delta.target.key_check, sizeof(key_check)) != 0) {
+			Fail(ProtectorStatus::kWrongKey, "Wrong key or IV for " + delta_file);
+			return DecryptedModel();
+		}
+		if (!base || base.size() != delta.base_size ||
+			base.content_digest() != delta.base_digest) {
+			Fail(ProtectorStatus::kChecksumMismatch,
+				 "Delta " + delta_file + " does not apply to " + base.source());
+			return DecryptedModel();
+		}
+
+		const size_t plain_size = static_cast<size_t>(delta.target.plaintext_size);
+		MemoryGovernor::Reservation reservation;
+		if (!AdmitLoad(delta_file, plain_size, &reservation)) {
+			return DecryptedModel();
+		}
+		DecryptedModel result;
+		if (!result.buffer_.Allocate(plain_size, buffer_policy_, prefault_buffer_, numa_node_)) {
+			Fail(ProtectorStatus::kAllocationError, "Failed to allocate model buffer");
+			return DecryptedModel();
+		}
+		uint8_t* out = reinterpret_cast<uint8_t*>(result.buffer_.data());
+		std::memcpy(out, base.data(), std::min(base.size(), plain_size));
+
+		ChunkedCbcDecryptor decryptor(kEncryptionKey, kEncryptionIv, ModelHeader::kChunkSize);
+		const size_t body_size = ModelHeader::CipherSize(plain_size);
+		const uint64_t last_chunk = delta.target.chunk_count() - 1;
+		std::vector<uint8_t> final_chunk(ModelHeader::kChunkSize);
+		uint8_t index_bytes[DeltaHeader::kIndexSize];
+		uint64_t index = 0;
+		ProtectorStatus status = ProtectorStatus::kOk;
+		for (uint64_t record = 0; status == ProtectorStatus::kOk && record < delta.chunk_count;
+			 ++record) {
+			status = OperationControl::Poll(record * ModelHeader::kChunkSize,
+											delta.chunk_count * ModelHeader::kChunkSize);
+			if (status != ProtectorStatus::kOk) {
+				break;
+			}
+			const uint64_t previous = index;
+			if (!in.Read(index_bytes, sizeof(index_bytes))) {
+				status = ProtectorStatus::kTruncated;
+				break;
+			}
+			index = DeltaHeader::ParseIndex(index_bytes);
+			if (index > last_chunk || (record > 0 && index <= previous)) {
+				status = ProtectorStatus::kBadHeader;
+				break;
+			}
+			ScopedTrace chunk_trace("decrypt");
+			const size_t offset = index * ModelHeader::kChunkSize;
+			const size_t length = std::min(ModelHeader::kChunkSize, body_size - offset);
+			uint8_t* target = index == last_chunk ? final_chunk.data() : out + offset;
+			if (!in.Read(target, length)) {
+				status = ProtectorStatus::kTruncated;
+			} else if (!decryptor.SeekToChunk(index) ||
+					   !decryptor.DecryptBlocks(target, target,
+												length / AesCbcDecryptor::kBlockSize -
+													(index == last_chunk ? 1 : 0))) {
+				status = ProtectorStatus::kCipherError;
+			} else if (index == last_chunk) {
+				// The padded final block: strip it and place the remaining plaintext.
+				const size_t bulk = length - AesCbcDecryptor::kBlockSize;
+				uint8_t last_plain[AesCbcDecryptor::kBlockSize];
+				size_t tail = 0;
+				if (!DecryptFinalBlock(decryptor.chaining_value(), target + bulk, last_plain,
+									   &tail) ||
+					offset + bulk + tail != plain_size) {
+					status = ProtectorStatus::kWrongKey;
+				} else {
+					std::memcpy(out + offset, final_chunk.data(), bulk);
+					std::memcpy(out + offset + bulk, last_plain, tail);
+				}
+				OPENSSL_cleanse(last_plain, sizeof(last_plain));
+			}
+		}
+		OPENSSL_cleanse(final_chunk.data(), final_chunk.size());
+		if (status != ProtectorStatus::kOk) {
+			Fail(status, "Failed to apply delta " + delta_file);
+			return DecryptedModel();
+		}
+
+		{
+			ScopedTrace checksum_trace("checksum");
+			result.content_digest_ = Xxh3Hasher::Hash(out, plain_size);
+		}
+		if (result.content_digest_ != delta.target.content_digest) {
+			Fail(ProtectorStatus::kChecksumMismatch,
+				 "Delta " + delta_file + " produced a model with the wrong digest");
+			return DecryptedModel();
+		}
+		result.buffer_.Resize(plain_size);
+		ProtectorMetrics::Instance().RecordDecrypt(plain_size,
+												   std::chrono::steady_clock::now() - start);
+
+		const auto decrypted = std::chrono::steady_clock::now();
+		result.model_ = LoadModel(result.buffer_);
+		if (!result.model_) {
+			Fail(ProtectorStatus::kInvalidModel, "Not a valid TFLite model: " + delta_file);
+			return DecryptedModel();
+		}
+		using std::chrono::duration_cast;
+		result.timings_.decrypt = duration_cast<std::chrono::nanoseconds>(decrypted - start);
+		result.timings_.build =
+			duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - decrypted);
+		result.source_ = delta_file;
+		return result;
 	} catch (const std::exception& e) {
 		LOGE("Exception caught: " + std::string(e.what()));
+		return DecryptedModel();
+	}
+}
+
+/**
+ * @brief Runs LoadDecryptedModel() as a task on the protector's executor (see SetExecutor()).
+ *
+ * Meant for hot reloads and lazy loads while the process is serving: with
+ * ThreadPolicy::Background() the decryption only uses CPU time and disk bandwidth that inference
+ * leaves idle. Loads beyond the executor's concurrency queue instead of starting threads. The
+ * protector must outlive the future. A failed load yields an empty DecryptedModel; the worker's
+ * LastStatus() is not visible to the caller, the cause is logged.
+ *
+ * The calling thread's OperationControl, if any, is copied into the task: cancelling its token
+ * or passing its deadline abandons the load, even while it is still queued.
+ *
+ * @param model_path The file path to the encrypted model.
+ */
+std::future<DecryptedModel> TFLiteModelProtector::LoadDecryptedModelAsync(
+	const std::string& model_path) {
+	const OperationControl* current = OperationControl::Current();
+	auto control = current != nullptr ? std::make_shared<OperationControl>(*current) : nullptr;
+	auto load = std::make_shared<std::packaged_task<DecryptedModel()>>(
+		[this, model_path, control]() {
+			ScopedOperationControl scope(control.get());
+			return LoadDecryptedModel(model_path);
+		});
+	std::future<DecryptedModel> result = load->get_future();
+	Executor().Submit([load]() { (*load)(); });
+	return result;
+}
+
+/**
+ * @brief Loads a model that may be shared, joining any identical load already in progress.
+ *
+ * When many threads ask for the same model at once (a cold start, or right after eviction),
+ * only the first one decrypts it; the others wait for that load and get the same handle. Loads
+ * are identical when the path, the file version (device, inode, size and mtime), the key and the
+ * buffer placement options match. Only in-flight loads are shared; a later call loads again.
+ *
+ * Unless disabled with SetDeduplicateModels(), the result is also interned in ModelDeduplicator:
+ * if a live model with byte-identical plaintext exists, from any path or key, that model is
+ * returned and the fresh copy is released.
+ *
+ * A joined thread keeps polling its own OperationControl while it waits, and gives up with
+ * kCancelled or kDeadlineExceeded without disturbing the leader. If the leader's control abandons
+ * the load, joined threads whose own control still allows it try again, and one of them leads
+ * the new load.
+ *
+ * @param model_path The file path to the encrypted model.
+ * @return The shared model, or nullptr on failure. LastStatus() reports the leader's status on
+ *         every joined thread.
+ */
+std::shared_ptr<const DecryptedModel> TFLiteModelProtector::LoadSharedModel(
+	const std::string& model_path) {
+	last_status_ = ProtectorStatus::kOk;
+	LoadKey key;
+	if (!MakeLoadKey(model_path, &key)) {
+		Fail(ProtectorStatus::kFileOpenError, "File open error: " + model_path);
 		return nullptr;
 	}
+
+	bool joined = false;
+	ProtectorStatus gave_up = ProtectorStatus::kOk;
+	auto give_up = [&gave_up]() {
+		gave_up = OperationControl::Poll();
+		return gave_up != ProtectorStatus::kOk;
+	};
+	SharedLoad load;
+	do {
+		load = in_flight_loads_.Do(
+			key,
+			[&]() {
+				SharedLoad result;
+				DecryptedModel model = LoadDecryptedModel(model_path);
+				if (model && deduplicate_models_) {
+					bool shared = false;
+					result.model = ModelDeduplicator::Instance().Intern(std::move(model), &shared);
+					if (shared) {
+						ProtectorMetrics::Instance().RecordCacheHit(MetricsCache::kContentDedup);
+					} else {
+						ProtectorMetrics::Instance().RecordCacheMiss(MetricsCache::kContentDedup);
+					}
+				} else if (model) {
+					result.model = std::make_shared<const DecryptedModel>(std::move(model));
+				}
+				result.status = last_status_;
+				return result;
+			},
+			&joined, give_up);
+		if (gave_up != ProtectorStatus::kOk) {
+			Fail(gave_up, "Gave up waiting for the shared load of " + model_path);
+			return nullptr;
+		}
+	} while (joined &&
+			 (load.status == ProtectorStatus::kCancelled ||
+			  load.status == ProtectorStatus::kDeadlineExceeded) &&
+			 OperationControl::Poll() == ProtectorStatus::kOk);
+
+	if (joined) {
+		ScopedTrace trace("single_flight_join", model_path);
+		ProtectorMetrics::Instance().RecordCacheHit(MetricsCache::kSingleFlight);
+		last_status_ = load.status;
+	} else {
+		ProtectorMetrics::Instance().RecordCacheMiss(MetricsCache::kSingleFlight);
+	}
+	return load.model;
+}
+
+/**
+ * @brief Fills in the single-flight key for a load of `model_path` with the current settings.
+ */
+bool TFLiteModelProtector::MakeLoadKey(const std::string& model_path, LoadKey* key) {
+	struct stat st = {};
+	if (stat(model_path.c_str(), &st) != 0) {
+		return false;
+	}
+	uint8_t key_check[ModelHeader::kKeyCheckLength];
+	if (!ModelHeader::ComputeKeyCheck(kEncryptionKey, kEncryptionIv, key_check)) {
+		return false;
+	}
+	key->path = model_path;
+	key->device = static_cast<uint64_t>(st.st_dev);
+	key->inode = static_cast<uint64_t>(st.st_ino);
+	key->size = static_cast<uint64_t>(st.st_size);
+	key->mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+	std::memcpy(&key->key_check, key_check, sizeof(key->key_check));
+	key->policy = static_cast<int>(buffer_policy_);
+	key->prefault = prefault_buffer_;
+	key->numa_node = numa_node_;
+	return true;
+}
+
+/**
+ * @brief Restores an encrypted XNNPACK weight cache into a memory file.
+ *
+ * Pass cache.path() as TfLiteXNNPackDelegateOptions::weight_cache_file_path. When the stored
+ * cache is valid, XNNPACK maps the packed weights from it instead of packing them again; when it
+ * is missing or unusable the memory file starts empty and XNNPACK fills it while the delegate is
+ * applied. Either way the plaintext only exists in memory. Call SaveWeightCache() afterwards.
+ *
+ * @param encrypted_cache_file The cache written by SaveWeightCache(), see WeightCachePath().
+ * @param cache Receives the memory file; it must outlive the interpreter creation.
+ * @return false only if the memory file could not be created. A stored cache that fails to
+ *         decrypt is logged, reported by LastStatus() and ignored.
+ */
+bool TFLiteModelProtector::OpenWeightCache(const std::string& encrypted_cache_file,
+										   MemoryFile& cache) {
+	ScopedTrace trace("OpenWeightCache", encrypted_cache_file);
+	last_status_ = ProtectorStatus::kOk;
+	if (!cache.Create("tflite_xnnpack_cache")) {
+		return Fail(ProtectorStatus::kAllocationError, "Failed to create weight cache memory file");
+	}
+	if (access(encrypted_cache_file.c_str(), F_OK) != 0) {
+		return true;
+	}
+
+	SequentialFile in;
+	EncryptedFileInfo info;
+	if (!OpenEncryptedFile(encrypted_cache_file, in, &info) || info.plaintext_capacity == 0) {
+		return true;
+	}
+	ProtectorStatus status = ProtectorStatus::kAllocationError;
+	void* data = MAP_FAILED;
+	if (ftruncate(cache.fd(), static_cast<off_t>(info.plaintext_capacity)) == 0) {
+		data = mmap(nullptr, info.plaintext_capacity, PROT_READ | PROT_WRITE, MAP_SHARED,
+					cache.fd(), 0);
+	}
+	if (data != MAP_FAILED) {
+		size_t plain_size = 0;
+		status = DecryptBody(in, info, static_cast<uint8_t*>(data), &plain_size)
+					 ? ProtectorStatus::kOk
+					 : last_status_;
+		munmap(data, info.plaintext_capacity);
+		if (status == ProtectorStatus::kOk &&
+			ftruncate(cache.fd(), static_cast<off_t>(plain_size)) != 0) {
+			status = ProtectorStatus::kIoError;
+		}
+	}
+	if (status != ProtectorStatus::kOk) {
+		// Start over with an empty file; XNNPACK rebuilds the cache into it.
+		cache.Create("tflite_xnnpack_cache");
+		Fail(status, "Ignoring unusable weight cache " + encrypted_cache_file);
+	}
+	return cache.valid();
+}
+
+/**
+ * @brief Encrypts the weight cache built by XNNPACK next to the model, with this protector's key.
+ *
+ * Call once the interpreter has applied the XNNPACK delegate. Nothing is written when the cache
+ * is empty or when `encrypted_cache_file` already holds the same contents under the same key, so
+ * calling this on every start is cheap. The file is replaced atomically.
+ *
+ * @param cache The memory file passed to XNNPACK, from OpenWeightCache().
+ * @param encrypted_cache_file The destination, see WeightCachePath().
+ * @return true if the stored cache is up to date.
+ */
+bool TFLiteModelProtector::SaveWeightCache(const MemoryFile& cache,
+										   const std::string& encrypted_cache_file) {
+	ScopedTrace trace("SaveWeightCache", encrypted_cache_file);
+	last_status_ = ProtectorStatus::kOk;
+	const size_t size = cache.size();
+	if (size == 0) {
+		return true;
+	}
+
+	void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, cache.fd(), 0);
+	if (data == MAP_FAILED) {
+		return Fail(ProtectorStatus::kIoError, "Failed to map weight cache");
+	}
+	const uint64_t digest = Xxh3Hasher::Hash(data, size);
+	munmap(data, size);
+
+	std::ifstream existing(encrypted_cache_file, std::ios::binary);
+	uint8_t header_bytes[ModelHeader::kSize];
+	uint8_t key_check[ModelHeader::kKeyCheckLength];
+	ModelHeader header;
+	if (existing.read(reinterpret_cast<char*>(header_bytes), sizeof(header_bytes)) &&
+		ModelHeader::Parse(header_bytes, sizeof(header_bytes), &header) &&
+		header.has_content_digest() && header.content_digest == digest &&
+		header.plaintext_size == size &&
+		ModelHeader::ComputeKeyCheck(kEncryptionKey, kEncryptionIv, key_check) &&
+		std::memcmp(key_check, header.key_check, sizeof(key_check)) == 0) {
+		return true;
+	}
+	existing.close();
+
+	const std::string temp_file = encrypted_cache_file + ".tmp";
+	if (!EncryptFile(cache.path(), temp_file)) {
+		std::remove(temp_file.c_str());
+		return false;
+	}
+	if (std::rename(temp_file.c_str(), encrypted_cache_file.c_str()) != 0) {
+		std::remove(temp_file.c_str());
+		return Fail(ProtectorStatus::kIoError, "Failed to replace " + encrypted_cache_file);
+	}
+	return true;
+}
+
+/**
+ * @brief Returns the conventional weight cache path for a model:
+ * `model.enc` -> `model.xnncache.enc`.
+ */
+std::string TFLiteModelProtector::WeightCachePath(const std::string& model_path) {
+	const size_t slash = model_path.find_last_of('/');
+	const size_t dot = model_path.find_last_of('.');
+	const bool has_extension =
+		dot != std::string::npos && (slash == std::string::npos || dot > slash);
+	return (has_extension ? model_path.substr(0, dot) : model_path) + ".xnncache.enc";
+}
+
+/**
+ * @brief Takes the load mutex, recording the time spent waiting for it.
+ *
+ * The calling thread's OperationControl is polled every kLockPollInterval while another load
+ * holds the mutex. If it cancels or its deadline passes, the wait is abandoned with that status
+ * and the returned lock does not own the mutex.
+ */
+std::unique_lock<std::timed_mutex> TFLiteModelProtector::LockForLoad(
+	const std::string& input_file) {
+	ProtectorMetrics& metrics = ProtectorMetrics::Instance();
+	const auto wait_start = std::chrono::steady_clock::now();
+	ScopedTrace trace("lock_wait", input_file);
+	std::unique_lock<std::timed_mutex> lock(mutex_, std::defer_lock);
+	while (!lock.try_lock_for(kLockPollInterval)) {
+		const ProtectorStatus control = OperationControl::Poll();
+		if (control != ProtectorStatus::kOk) {
+			metrics.RecordLockWait(std::chrono::steady_clock::now() - wait_start);
+			Fail(control, "Gave up waiting for the load lock for " + input_file);
+			return lock;
+		}
+	}
+	metrics.RecordLockWait(std::chrono::steady_clock::now() - wait_start);
+	return lock;
 }
 
 /**
@@ -185,4 +1882,83 @@ void TFLiteModelProtector::SetCustomKeyAndIv(const std::vector<uint8_t>& key,
 		iv_stream << std::hex << static_cast<int>(byte) << " ";
 	}
 	LOGI(iv_stream.str());
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Selects how decrypted model buffers are allocated.
+ *
+ * Large models benefit from huge pages: inference walks the weights with far fewer dTLB misses.
+ * With `prefault` set the pages are faulted in before decryption starts instead of on first touch.
+ *
+ * @param policy The allocation policy used by DecryptFileToMemory() and LoadEncryptedModel().
+ * @param prefault Whether to populate the buffer pages up front.
+ */
+void TFLiteModelProtector::SetBufferPolicy(BufferPolicy policy, bool prefault) {
+	buffer_policy_ = policy;
+	prefault_buffer_ = prefault;
+}
+
+/**
+ * @brief Selects whether ciphertext is dropped from the page cache once it has been decrypted.
+ *
+ * On by default: a loaded model then occupies memory once, as plaintext, instead of twice. Turn
+ * it off when the same encrypted file is loaded repeatedly and should stay cached.
+ */
+void TFLiteModelProtector::SetDropPageCache(bool drop) { drop_page_cache_ = drop; }
+
+/**
+ * @brief Sets the CPU set, scheduling class and I/O priority of the protector's worker threads.
+ *
+ * Selects the shared WorkStealingPool that runs ReEncryptFiles() and LoadDecryptedModelAsync()
+ * work: protectors with equal policies share one pool, whose workers apply the policy once when
+ * they start. Calls that do their work on the caller's thread are unaffected, and so is an
+ * executor set with SetExecutor(). Use ThreadPolicy::Background() so that background model
+ * preparation never preempts inference.
+ */
+void TFLiteModelProtector::SetWorkerPolicy(const ThreadPolicy& policy) { worker_policy_ = policy; }
+
+/**
+ * @brief Runs the protector's parallel work on `executor`, typically the host application's own
+ * pool, instead of TaskExecutor::Default(). nullptr restores the default.
+ */
+void TFLiteModelProtector::SetExecutor(std::shared_ptr<TaskExecutor> executor) {
+	executor_ = std::move(executor);
+}
+
+TaskExecutor& TFLiteModelProtector::Executor() {
+	return executor_ ? *executor_ : TaskExecutor::Default(worker_policy_);
+}
+
+/**
+ * @brief Makes loads that allocate their own plaintext buffer wait for the governor's admission.
+ *
+ * Several protectors may share one governor; pass nullptr to stop admission control. Loads that
+ * are deferred past MemoryGovernor::Options::max_defer fail with kMemoryPressure.
+ */
+void TFLiteModelProtector::SetMemoryGovernor(std::shared_ptr<MemoryGovernor> governor) {
+	memory_governor_ = std::move(governor);
+}
+
+/**
+ * @brief Selects whether LoadSharedModel() shares byte-identical models between loads.
+ *
+ * On by default. A shared model keeps the source() of the load that created it.
+ */
+void TFLiteModelProtector::SetDeduplicateModels(bool deduplicate) {
+	deduplicate_models_ = deduplicate;
+}
+
+/**
+ * @brief Selects the chunked layout for files written by EncryptFile().
+ *
+ * Off by default, for compatibility with readers that predate it. Chunked files decrypt at the
+ * same speed and are required for CreateDelta(). ReEncrypt() keeps the layout of its input.
+ */
+void TFLiteModelProtector::SetChunkedFormat(bool chunked) { chunked_output_ = chunked; }
+
+/**
+ * @brief Binds decryption and decrypted buffers to a NUMA node.
+ *
+ * @param node The node to use, or -1 to leave placement to the kernel.
+ */
+void TFLiteModelProtector::SetNumaNode(int node) { numa_node_ = node; }
\ No newline at end of file
@@ -0,0 +1,173 @@
+#include "numa_placement.hpp"
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace {
+
+constexpr int kMpolBind = 2;		 // MPOL_BIND from <linux/mempolicy.h>
+constexpr int kMpolMfMove = 1 << 1;	 // MPOL_MF_MOVE
+constexpr int kMaxNodes = 1024;
+
+/**
+ * @brief Parses a sysfs list such as "0-3,8,10-11" and calls `fn` for every entry.
+ */
+template <typename Fn>
+bool ForEachInList(const std::string& path, Fn fn) {
+	std::ifstream in(path);
+	std::string list;
+	if (!in || !std::getline(in, list)) {
+		return false;
+	}
+	std::stringstream ranges(list);
+	std::string range;
+	while (std::getline(ranges, range, ',')) {
+		if (range.empty()) {
+			continue;
+		}
+		const size_t dash = range.find('-');
+		const int first = std::stoi(range.substr(0, dash));
+		const int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+		for (int i = first; i <= last; ++i) {
+			fn(i);
+		}
+	}
+	return true;
+}
+
+}  // namespace
+
+/**
+ * @brief Returns the number of online NUMA nodes, 1 on non-NUMA systems.
+ */
+int NumaTopology::NodeCount() {
+	int highest = 0;
+	if (!ForEachInList("/sys/devices/system/node/online",
+					   [&](int node) { highest = std::max(highest, node); })) {
+		return 1;
+	}
+	return highest + 1;
+}
+
+/**
+ * @brief Returns the online nodes that have both memory and CPUs, in ascending order.
+ *
+ * These are the nodes a replica can be placed on and used from. Node ids may be sparse, and
+ * memory-only nodes (CXL, HBM) or CPU-only nodes are left out. Non-NUMA systems get {0}.
+ */
+std::vector<int> NumaTopology::ReplicaNodes() {
+	std::vector<int> online;
+	if (!ForEachInList("/sys/devices/system/node/online",
+					   [&](int node) { online.push_back(node); })) {
+		return {0};
+	}
+	std::vector<bool> has_memory(kMaxNodes, true);
+	std::vector<bool> listed(kMaxNodes, false);
+	if (ForEachInList("/sys/devices/system/node/has_memory", [&](int node) {
+			if (node >= 0 && node < kMaxNodes) {
+				listed[node] = true;
+			}
+		})) {
+		has_memory = listed;
+	}
+	std::vector<int> nodes;
+	cpu_set_t cpus;
+	for (const int node : online) {
+		if (node >= 0 && node < kMaxNodes && has_memory[node] && CpusOfNode(node, &cpus)) {
+			nodes.push_back(node);
+		}
+	}
+	if (nodes.empty()) {
+		nodes.push_back(online.empty() ? 0 : online.front());
+	}
+	return nodes;
+}
+
+/**
+ * @brief Returns the node of the CPU the calling thread is currently running on.
+ */
+int NumaTopology::CurrentNode() {
+	unsigned cpu = 0;
+	unsigned node = 0;
+	if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) {
+		return 0;
+	}
+	return static_cast<int>(node);
+}
+
+/**
+ * @brief Fills `cpus` with the CPUs that belong to `node`.
+ *
+ * @return false if the node does not exist.
+ */
+bool NumaTopology::CpusOfNode(int node, cpu_set_t* cpus) {
+	CPU_ZERO(cpus);
+	const std::string path = "/sys/devices/system/node/node" + std::to_string(node) + "/cpulist";
+	return ForEachInList(path, [&](int cpu) { CPU_SET(cpu, cpus); }) && CPU_COUNT(cpus) > 0;
+}
+
+/**
+ * @brief Binds a page-aligned range to `node` with mbind(MPOL_BIND).
+ *
+ * Must be called before the range is touched; pages already faulted elsewhere are migrated.
+ */
+bool NumaTopology::BindMemory(void* addr, size_t length, int node) {
+	if (node < 0 || node >= kMaxNodes) {
+		return false;
+	}
+	unsigned long mask[kMaxNodes / (8 * sizeof(unsigned long))] = {};
+	mask[node / (8 * sizeof(unsigned long))] = 1UL << (node % (8 * sizeof(unsigned long)));
+	return syscall(SYS_mbind, addr, length, kMpolBind, mask, kMaxNodes, kMpolMfMove) == 0;
+}
+
+ScopedNodeAffinity::ScopedNodeAffinity(int node) {
+	cpu_set_t cpus;
+	if (node < 0 || !NumaTopology::CpusOfNode(node, &cpus)) {
+		return;
+	}
+	if (sched_getaffinity(0, sizeof(previous_), &previous_) != 0) {
+		return;
+	}
+	active_ = sched_setaffinity(0, sizeof(cpus), &cpus) == 0;
+}
+
+ScopedNodeAffinity::~ScopedNodeAffinity() {
+	if (active_) {
+		sched_setaffinity(0, sizeof(previous_), &previous_);
+	}
+}
+
+NumaReplicatedModel::~NumaReplicatedModel() {
+	// Models reference their buffers, so they have to go first.
+	models_.clear();
+}
+
+size_t NumaReplicatedModel::replica_count() const {
+	return static_cast<size_t>(std::count_if(models_.begin(), models_.end(),
+											 [](const auto& model) { return model != nullptr; }));
+}
+
+/**
+ * @brief Returns the replica on the calling thread's current node.
+ */
+const tflite::FlatBufferModel* NumaReplicatedModel::Local() const {
+	return ForNode(NumaTopology::CurrentNode());
+}
+
+/**
+ * @brief Returns the replica on `node`, or the primary replica if that node has none.
+ */
+const tflite::FlatBufferModel* NumaReplicatedModel::ForNode(int node) const {
+	if (static_cast<size_t>(primary_node_) >= models_.size()) {
+		return nullptr;
+	}
+	if (node < 0 || static_cast<size_t>(node) >= models_.size() || !models_[node]) {
+		return models_[primary_node_].get();
+	}
+	return models_[node].get();
+}
@@ -0,0 +1,45 @@
+#include "operation_control.hpp"
+
+namespace {
+
+thread_local const OperationControl* current_control = nullptr;
+
+}  // namespace
+
+/**
+ * @brief Tells whether the operation may go on: kCancelled, kDeadlineExceeded or kOk.
+ *
+ * The clock is read only when a deadline is set.
+ */
+ProtectorStatus OperationControl::Status() const {
+	if (token.cancelled()) {
+		return ProtectorStatus::kCancelled;
+	}
+	if (deadline != Clock::time_point::max() && Clock::now() >= deadline) {
+		return ProtectorStatus::kDeadlineExceeded;
+	}
+	return ProtectorStatus::kOk;
+}
+
+const OperationControl* OperationControl::Current() { return current_control; }
+
+ProtectorStatus OperationControl::Poll() {
+	return current_control != nullptr ? current_control->Status() : ProtectorStatus::kOk;
+}
+
+ProtectorStatus OperationControl::Poll(uint64_t done, uint64_t total) {
+	if (current_control == nullptr) {
+		return ProtectorStatus::kOk;
+	}
+	if (current_control->progress) {
+		current_control->progress(done, total);
+	}
+	return current_control->Status();
+}
+
+ScopedOperationControl::ScopedOperationControl(const OperationControl* control)
+	: previous_(current_control) {
+	current_control = control;
+}
+
+ScopedOperationControl::~ScopedOperationControl() { current_control = previous_; }
@@ -0,0 +1,215 @@
+#include "protector_metrics.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+constexpr const char* kCacheNames[] = {"locked_arena", "single_flight", "model_cache",
+									   "content_dedup"};
+
+void RenderHeader(std::ostringstream& out, const char* name, const char* type, const char* help) {
+	out << "# HELP " << name << ' ' << help << '\n';
+	out << "# TYPE " << name << ' ' << type << '\n';
+}
+
+void RenderHistogram(std::ostringstream& out, const char* name, const char* help,
+					 const ShardedHistogram& histogram) {
+	std::array<uint64_t, ShardedHistogram::kBuckets> cumulative;
+	uint64_t count = 0;
+	double sum = 0;
+	histogram.Snapshot(&cumulative, &count, &sum);
+
+	RenderHeader(out, name, "histogram", help);
+	for (size_t i = 0; i < ShardedHistogram::kBuckets; ++i) {
+		out << name << "_bucket{le=\"" << ShardedHistogram::Bounds()[i] << "\"} " << cumulative[i]
+			<< '\n';
+	}
+	out << name << "_bucket{le=\"+Inf\"} " << count << '\n';
+	out << name << "_sum " << sum << '\n';
+	out << name << "_count " << count << '\n';
+}
+
+}  // namespace
+
+/**
+ * @brief Returns a small per-thread index, assigned round-robin the first time a thread asks.
+ */
+size_t ShardedCounter::ThreadShard() {
+	static std::atomic<size_t> next_thread{0};
+	thread_local const size_t shard = next_thread.fetch_add(1, std::memory_order_relaxed) % kShards;
+	return shard;
+}
+
+void ShardedCounter::Add(uint64_t delta) {
+	shards_[ThreadShard()].value.fetch_add(delta, std::memory_order_relaxed);
+}
+
+uint64_t ShardedCounter::Value() const {
+	uint64_t total = 0;
+	for (const Shard& shard : shards_) {
+		total += shard.value.load(std::memory_order_relaxed);
+	}
+	return total;
+}
+
+const std::array<double, ShardedHistogram::kBuckets>& ShardedHistogram::Bounds() {
+	static const std::array<double, kBuckets> bounds = {0.0001, 0.00025, 0.001, 0.0025, 0.01, 0.025,
+														0.1,	0.25,	 1,		2.5,	10};
+	return bounds;
+}
+
+void ShardedHistogram::Observe(std::chrono::nanoseconds duration) {
+	const double seconds = std::chrono::duration<double>(duration).count();
+	size_t bucket = 0;
+	while (bucket < kBuckets && seconds > Bounds()[bucket]) {
+		++bucket;
+	}
+	Shard& shard = shards_[ShardedCounter::ThreadShard()];
+	shard.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+	shard.sum_ns.fetch_add(static_cast<uint64_t>(duration.count()), std::memory_order_relaxed);
+}
+
+/**
+ * @brief Sums all shards. Concurrent Observe() calls may be partly included; the count and the
+ * buckets are read from the same pass so they always agree.
+ */
+void ShardedHistogram::Snapshot(std::array<uint64_t, kBuckets>* cumulative, uint64_t* count,
+								double* sum) const {
+	std::array<uint64_t, kBuckets + 1> totals{};
+	uint64_t sum_ns = 0;
+	for (const Shard& shard : shards_) {
+		for (size_t i = 0; i <= kBuckets; ++i) {
+			totals[i] += shard.buckets[i].load(std::memory_order_relaxed);
+		}
+		sum_ns += shard.sum_ns.load(std::memory_order_relaxed);
+	}
+	uint64_t running = 0;
+	for (size_t i = 0; i < kBuckets; ++i) {
+		running += totals[i];
+		(*cumulative)[i] = running;
+	}
+	*count = running + totals[kBuckets];
+	*sum = static_cast<double>(sum_ns) / 1e9;
+}
+
+/**
+ * @brief Returns the process-wide registry.
+ */
+ProtectorMetrics& ProtectorMetrics::Instance() {
+	// Leaked like LockedArena::Instance(), so loads during static destruction can still record.
+	static ProtectorMetrics* metrics = new ProtectorMetrics();
+	return *metrics;
+}
+
+void ProtectorMetrics::RecordDecrypt(uint64_t bytes, std::chrono::nanoseconds duration) {
+	bytes_decrypted_.Add(bytes);
+	decrypt_latency_.Observe(duration);
+}
+
+void ProtectorMetrics::RecordFailure(ProtectorStatus status) {
+	failures_[static_cast<size_t>(status)].Add();
+}
+
+void ProtectorMetrics::RecordCacheHit(MetricsCache cache) {
+	cache_hits_[static_cast<size_t>(cache)].Add();
+}
+
+void ProtectorMetrics::RecordCacheMiss(MetricsCache cache) {
+	cache_misses_[static_cast<size_t>(cache)].Add();
+}
+
+/**
+ * @brief Renders every metric in the Prometheus text exposition format (version 0.0.4).
+ */
+std::string ProtectorMetrics::Render() const {
+	std::ostringstream out;
+
+	RenderHeader(out, "tflite_protector_loads_total", "counter", "Encrypted model loads started.");
+	out << "tflite_protector_loads_total " << loads_.Value() << '\n';
+
+	RenderHeader(out, "tflite_protector_decrypted_bytes_total", "counter",
+				 "Plaintext bytes produced by successful decryptions.");
+	out << "tflite_protector_decrypted_bytes_total " << bytes_decrypted_.Value() << '\n';
+
+	RenderHistogram(out, "tflite_protector_decrypt_duration_seconds",
+					"Time to read, decrypt and check one encrypted model.", decrypt_latency_);
+	RenderHistogram(out, "tflite_protector_lock_wait_seconds",
+					"Time spent waiting for the protector load lock.", lock_wait_);
+
+	RenderHeader(out, "tflite_protector_cache_hits_total", "counter", "Cache lookups that hit.");
+	for (size_t i = 0; i < kCacheKinds; ++i) {
+		out << "tflite_protector_cache_hits_total{cache=\"" << kCacheNames[i] << "\"} "
+			<< cache_hits_[i].Value() << '\n';
+	}
+	RenderHeader(out, "tflite_protector_cache_misses_total", "counter",
+				 "Cache lookups that missed.");
+	for (size_t i = 0; i < kCacheKinds; ++i) {
+		out << "tflite_protector_cache_misses_total{cache=\"" << kCacheNames[i] << "\"} "
+			<< cache_misses_[i].Value() << '\n';
+	}
+
+	RenderHeader(out, "tflite_protector_failures_total", "counter", "Failed operations by cause.");
+	for (size_t i = 1; i < kProtectorStatusCount; ++i) {
+		out << "tflite_protector_failures_total{cause=\""
+			<< ProtectorStatusName(static_cast<ProtectorStatus>(i)) << "\"} "
+			<< failures_[i].Value() << '\n';
+	}
+	return out.str();
+}
+
+/**
+ * @brief Starts a background thread that passes Render() to `sink` every `interval`.
+ *
+ * A running exporter is stopped first. The sink runs on the exporter thread and must not call
+ * StartExporter() or StopExporter().
+ */
+void ProtectorMetrics::StartExporter(Sink sink, std::chrono::milliseconds interval) {
+	StopExporter();
+	std::lock_guard<std::mutex> lock(exporter_mutex_);
+	exporter_stop_ = false;
+	exporter_ = std::thread([this, sink = std::move(sink), interval]() {
+		std::unique_lock<std::mutex> lock(exporter_mutex_);
+		while (!exporter_wakeup_.wait_for(lock, interval, [this]() { return exporter_stop_; })) {
+			lock.unlock();
+			sink(Render());
+			lock.lock();
+		}
+	});
+}
+
+/**
+ * @brief Writes Render() to `path` every `interval`.
+ *
+ * Each snapshot is written to `path`.tmp and renamed over `path`, so readers never see a partial
+ * file.
+ */
+void ProtectorMetrics::StartFileExporter(const std::string& path,
+										 std::chrono::milliseconds interval) {
+	StartExporter(
+		[path](const std::string& text) {
+			const std::string temp_path = path + ".tmp";
+			std::ofstream out(temp_path, std::ios::trunc);
+			out << text;
+			out.close();
+			if (!out || std::rename(temp_path.c_str(), path.c_str()) != 0) {
+				std::remove(temp_path.c_str());
+			}
+		},
+		interval);
+}
+
+/**
+ * @brief Stops the exporter thread, if any, and waits for it to exit.
+ */
+void ProtectorMetrics::StopExporter() {
+	{
+		std::lock_guard<std::mutex> lock(exporter_mutex_);
+		exporter_stop_ = true;
+	}
+	exporter_wakeup_.notify_all();
+	if (exporter_.joinable()) {
+		exporter_.join();
+	}
+}
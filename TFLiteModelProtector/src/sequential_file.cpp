@@ -0,0 +1,114 @@
+#include "sequential_file.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+SequentialFile::~SequentialFile() { Close(); }
+
+/**
+ * @brief Opens `path` for reading and advises sequential access.
+ */
+bool SequentialFile::Open(const std::string& path) {
+	Close();
+	fd_ = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	struct stat st = {};
+	if (fd_ < 0 || fstat(fd_, &st) != 0) {
+		Close();
+		return false;
+	}
+	size_ = static_cast<size_t>(st.st_size);
+	posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+	return true;
+}
+
+/**
+ * @brief Reads from `size` bytes at `data`, which must stay valid while this object is used.
+ */
+void SequentialFile::OpenMemory(const void* data, size_t size) {
+	Close();
+	memory_ = static_cast<const uint8_t*>(data);
+	size_ = size;
+}
+
+void SequentialFile::Close() {
+	if (fd_ >= 0) {
+		close(fd_);
+	}
+	fd_ = -1;
+	memory_ = nullptr;
+	size_ = 0;
+	offset_ = 0;
+}
+
+/**
+ * @brief Reads exactly `length` bytes at the current offset.
+ *
+ * @return false on an I/O error or if the file ends first.
+ */
+bool SequentialFile::Read(void* out, size_t length) {
+	if (memory_ != nullptr) {
+		if (length > size_ - offset_) {
+			return false;
+		}
+		std::memcpy(out, memory_ + offset_, length);
+		offset_ += length;
+		return true;
+	}
+	char* dest = static_cast<char*>(out);
+	while (length > 0) {
+		const ssize_t n = pread(fd_, dest, length, static_cast<off_t>(offset_));
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			return false;
+		}
+		dest += n;
+		length -= static_cast<size_t>(n);
+		offset_ += static_cast<size_t>(n);
+	}
+	return true;
+}
+
+/**
+ * @brief Returns the next `length` bytes and advances past them.
+ *
+ * From memory this points into the caller's buffer; from a file the bytes are read into
+ * `scratch` and `scratch` is returned.
+ *
+ * @return nullptr on an I/O error or if the input ends first.
+ */
+const uint8_t* SequentialFile::Next(uint8_t* scratch, size_t length) {
+	if (memory_ != nullptr) {
+		if (length > size_ - offset_) {
+			return nullptr;
+		}
+		const uint8_t* data = memory_ + offset_;
+		offset_ += length;
+		return data;
+	}
+	return Read(scratch, length) ? scratch : nullptr;
+}
+
+bool SequentialFile::Seek(size_t offset) {
+	if (offset > size_) {
+		return false;
+	}
+	offset_ = offset;
+	return true;
+}
+
+/**
+ * @brief Drops the cached pages of everything before the current offset.
+ *
+ * Only a hint: dirty pages, and pages other processes have mapped, stay cached.
+ */
+void SequentialFile::DropConsumed() {
+	if (fd_ >= 0 && offset_ > 0) {
+		posix_fadvise(fd_, 0, static_cast<off_t>(offset_), POSIX_FADV_DONTNEED);
+	}
+}
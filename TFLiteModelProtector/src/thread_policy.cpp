@@ -0,0 +1,78 @@
+#include "thread_policy.hpp"
+
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+namespace {
+
+// From <linux/ioprio.h>, which glibc does not wrap.
+constexpr int kIoprioWhoProcess = 1;
+constexpr int kIoprioClassShift = 13;
+constexpr int kIoprioClassBestEffort = 2;
+constexpr int kIoprioClassIdle = 3;
+
+}  // namespace
+
+ThreadPolicy ThreadPolicy::Background() {
+	ThreadPolicy policy;
+	policy.idle = true;
+	policy.io_class = IoClass::kIdle;
+	return policy;
+}
+
+bool ThreadPolicy::is_default() const {
+	return cpus.empty() && !idle && nice == 0 && io_class == IoClass::kInherit;
+}
+
+bool ThreadPolicy::operator==(const ThreadPolicy& other) const {
+	return cpus == other.cpus && idle == other.idle && nice == other.nice &&
+		   io_class == other.io_class && io_level == other.io_level;
+}
+
+/**
+ * @brief Applies the policy to the calling thread.
+ *
+ * Every setting is attempted even if an earlier one fails, so a CPU list naming offline CPUs
+ * still leaves the thread at its lower priority.
+ *
+ * @return false if any setting was rejected by the kernel.
+ */
+bool ThreadPolicy::ApplyToCurrentThread() const {
+	bool ok = true;
+	const pid_t tid = static_cast<pid_t>(syscall(SYS_gettid));
+
+	if (!cpus.empty()) {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (const int cpu : cpus) {
+			if (cpu >= 0 && cpu < CPU_SETSIZE) {
+				CPU_SET(cpu, &set);
+			}
+		}
+		ok &= sched_setaffinity(0, sizeof(set), &set) == 0;
+	}
+
+	if (idle) {
+		sched_param param = {};
+		ok &= sched_setscheduler(0, SCHED_IDLE, &param) == 0;
+	} else if (nice != 0) {
+		// On Linux the nice value is per thread when addressed by thread id.
+		errno = 0;
+		const int current = getpriority(PRIO_PROCESS, static_cast<id_t>(tid));
+		ok &= errno == 0 &&
+			  setpriority(PRIO_PROCESS, static_cast<id_t>(tid), current + nice) == 0;
+	}
+
+	if (io_class != IoClass::kInherit) {
+		const int io_priority =
+			io_class == IoClass::kIdle
+				? kIoprioClassIdle << kIoprioClassShift
+				: (kIoprioClassBestEffort << kIoprioClassShift) | (io_level & 7);
+		ok &= syscall(SYS_ioprio_set, kIoprioWhoProcess, tid, io_priority) == 0;
+	}
+	return ok;
+}
@@ -0,0 +1,154 @@
+#include "trace_events.hpp"
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <fstream>
+
+namespace {
+
+void WriteJsonString(std::ostream& out, const std::string& value) {
+	out << '"';
+	for (const char c : value) {
+		if (c == '"' || c == '\\') {
+			out << '\\' << c;
+		} else if (static_cast<unsigned char>(c) < 0x20) {
+			char escaped[8];
+			std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+			out << escaped;
+		} else {
+			out << c;
+		}
+	}
+	out << '"';
+}
+
+}  // namespace
+
+/**
+ * @brief Returns the process-wide recorder.
+ */
+TraceRecorder& TraceRecorder::Instance() {
+	// Leaked like ProtectorMetrics::Instance(), so threads exiting late can still record.
+	static TraceRecorder* recorder = new TraceRecorder();
+	return *recorder;
+}
+
+/**
+ * @brief Starts recording. Timestamps in the output are relative to the recorder's creation.
+ */
+void TraceRecorder::Start() { enabled_.store(true, std::memory_order_relaxed); }
+
+void TraceRecorder::Stop() { enabled_.store(false, std::memory_order_relaxed); }
+
+/**
+ * @brief Returns the calling thread's buffer, registering it on first use.
+ *
+ * The buffer is marked exited when the thread ends, so pools that come and go do not leave
+ * their buffers behind in buffers_; spans the thread recorded are still written once.
+ */
+TraceRecorder::ThreadBuffer& TraceRecorder::LocalBuffer() {
+	struct ExitGuard {
+		std::shared_ptr<ThreadBuffer> buffer;
+		~ExitGuard() {
+			if (buffer) {
+				std::lock_guard<std::mutex> lock(buffer->mutex);
+				buffer->exited = true;
+			}
+		}
+	};
+	thread_local ExitGuard local;
+	if (!local.buffer) {
+		local.buffer = std::make_shared<ThreadBuffer>();
+		local.buffer->tid = static_cast<int>(syscall(SYS_gettid));
+		std::lock_guard<std::mutex> lock(buffers_mutex_);
+		buffers_.push_back(local.buffer);
+	}
+	return *local.buffer;
+}
+
+void TraceRecorder::Record(const char* name, const std::string& model,
+						   std::chrono::steady_clock::time_point start,
+						   std::chrono::steady_clock::time_point end) {
+	ThreadBuffer& buffer = LocalBuffer();
+	std::lock_guard<std::mutex> lock(buffer.mutex);
+	using std::chrono::duration_cast;
+	using std::chrono::nanoseconds;
+	buffer.events.push_back(Event{name, model, duration_cast<nanoseconds>(start - origin_).count(),
+								  duration_cast<nanoseconds>(end - start).count()});
+}
+
+/**
+ * @brief Writes the recorded spans as a Chrome trace-event JSON file.
+ *
+ * Spans are complete ("X") events with microsecond timestamps, one track per thread. Recording
+ * may continue while the file is written; spans that finish meanwhile go to the next file.
+ * Buffers of threads that have exited are dropped once drained.
+ *
+ * @param path The output file.
+ * @return false if the file could not be written.
+ */
+bool TraceRecorder::WriteJson(const std::string& path) {
+	std::vector<std::pair<int, std::vector<Event>>> drained;
+	{
+		std::lock_guard<std::mutex> lock(buffers_mutex_);
+		size_t kept = 0;
+		for (std::shared_ptr<ThreadBuffer>& buffer : buffers_) {
+			bool exited;
+			{
+				std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+				drained.emplace_back(buffer->tid, std::move(buffer->events));
+				buffer->events.clear();
+				exited = buffer->exited;
+			}
+			if (!exited) {
+				buffers_[kept++] = std::move(buffer);
+			}
+		}
+		buffers_.resize(kept);
+	}
+
+	std::ofstream out(path, std::ios::trunc);
+	if (!out) {
+		return false;
+	}
+	const int pid = static_cast<int>(getpid());
+	char timing[64];
+	bool first = true;
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	for (const auto& thread_events : drained) {
+		for (const Event& event : thread_events.second) {
+			std::snprintf(timing, sizeof(timing), "\"ts\":%.3f,\"dur\":%.3f",
+						  static_cast<double>(event.start_ns) / 1e3,
+						  static_cast<double>(event.duration_ns) / 1e3);
+			out << (first ? "\n" : ",\n") << "{\"name\":\"" << event.name
+				<< "\",\"cat\":\"tflite_protector\",\"ph\":\"X\"," << timing << ",\"pid\":" << pid
+				<< ",\"tid\":" << thread_events.first;
+			if (!event.model.empty()) {
+				out << ",\"args\":{\"model\":";
+				WriteJsonString(out, event.model);
+				out << '}';
+			}
+			out << '}';
+			first = false;
+		}
+	}
+	out << "\n]}\n";
+	return static_cast<bool>(out);
+}
+
+ScopedTrace::ScopedTrace(const char* name, const std::string* model)
+	: name_(name), model_(model), active_(TraceRecorder::Instance().enabled()) {
+	if (active_) {
+		start_ = std::chrono::steady_clock::now();
+	}
+}
+
+ScopedTrace::~ScopedTrace() {
+	if (active_) {
+		static const std::string kNoModel;
+		TraceRecorder::Instance().Record(name_, model_ != nullptr ? *model_ : kNoModel, start_,
+										 std::chrono::steady_clock::now());
+	}
+}
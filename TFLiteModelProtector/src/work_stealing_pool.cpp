@@ -0,0 +1,292 @@
+#include "work_stealing_pool.hpp"
+
+#include <chrono>
+#include <utility>
+
+#include "cgroup.hpp"
+#include "logging.hpp"
+
+namespace {
+
+constexpr auto kHelpInterval = std::chrono::milliseconds(1);
+
+// The pool the calling thread works for, and its worker index there.
+thread_local const WorkStealingPool* current_pool = nullptr;
+thread_local size_t current_worker = 0;
+
+std::mutex registry_mutex;
+size_t shared_size = 0;  // 0 sizes shared pools by EffectiveCpuCount()
+TaskExecutor* host_executor = nullptr;
+
+}  // namespace
+
+/**
+ * @brief Installs the executor that Default() returns, in place of the shared pools.
+ *
+ * Call it at startup, before the library runs any work. A replaced executor is kept alive, since
+ * work already running may still refer to it; nullptr goes back to the shared pools.
+ */
+void TaskExecutor::SetDefault(std::shared_ptr<TaskExecutor> executor) {
+	static auto* installed = new std::vector<std::shared_ptr<TaskExecutor>>();
+	std::lock_guard<std::mutex> lock(registry_mutex);
+	installed->push_back(executor);
+	host_executor = executor.get();
+}
+
+/**
+ * @brief Returns the host executor set with SetDefault(), or else the shared pool for `policy`.
+ *
+ * A host executor runs every task under its own thread settings, so `policy` is ignored then.
+ */
+TaskExecutor& TaskExecutor::Default(const ThreadPolicy& policy) {
+	{
+		std::lock_guard<std::mutex> lock(registry_mutex);
+		if (host_executor != nullptr) {
+			return *host_executor;
+		}
+	}
+	return WorkStealingPool::Shared(policy);
+}
+
+/**
+ * @param threads Number of workers, 0 for EffectiveCpuCount().
+ * @param policy Applied to each worker when it starts.
+ */
+WorkStealingPool::WorkStealingPool(size_t threads, const ThreadPolicy& policy)
+	: policy_(policy), outside_helpers_(policy.is_default()) {
+	if (threads == 0) {
+		threads = EffectiveCpuCount();
+	}
+	for (size_t i = 0; i < threads; ++i) {
+		workers_.push_back(std::make_unique<Worker>());
+	}
+	for (size_t i = 0; i < threads; ++i) {
+		workers_[i]->thread = std::thread(&WorkStealingPool::WorkerLoop, this, i);
+	}
+}
+
+/**
+ * @brief Runs every task still queued, then joins the workers.
+ */
+WorkStealingPool::~WorkStealingPool() {
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex_);
+		stop_ = true;
+	}
+	wakeup_.notify_all();
+	for (const std::unique_ptr<Worker>& worker : workers_) {
+		worker->thread.join();
+	}
+}
+
+/**
+ * @brief Queues `task`: on the submitting worker's own deque, or on the injection queue when the
+ * caller is not one of this pool's workers.
+ */
+void WorkStealingPool::Submit(Task task) {
+	if (current_pool == this) {
+		Worker& worker = *workers_[current_worker];
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		worker.tasks.push_back(std::move(task));
+	} else {
+		std::lock_guard<std::mutex> lock(injection_mutex_);
+		injected_.push_back(std::move(task));
+	}
+	queued_.fetch_add(1, std::memory_order_release);
+	Wake();
+}
+
+/**
+ * @brief Runs one queued task on the calling thread, for a thread waiting on a TaskGroup.
+ *
+ * Workers of this pool always help. Other threads help only a pool with the default policy;
+ * running a background pool's work on the caller's thread would run it at the caller's priority.
+ *
+ * @return false if the caller may not help or nothing was queued.
+ */
+bool WorkStealingPool::RunPendingTask() {
+	Task task;
+	if (current_pool == this) {
+		if (!TakeTask(current_worker, &task)) {
+			return false;
+		}
+	} else if (!outside_helpers_ || !TakeTask(workers_.size(), &task)) {
+		return false;
+	}
+	Run(task);
+	return true;
+}
+
+/**
+ * @brief Returns the process-wide pool for `policy`, starting it on first use.
+ *
+ * Pools are never destroyed, so their workers outlive static destructors that might still submit.
+ */
+WorkStealingPool& WorkStealingPool::Shared(const ThreadPolicy& policy) {
+	static auto* pools = new std::vector<std::pair<ThreadPolicy, WorkStealingPool*>>();
+	std::lock_guard<std::mutex> lock(registry_mutex);
+	for (const auto& entry : *pools) {
+		if (entry.first == policy) {
+			return *entry.second;
+		}
+	}
+	pools->emplace_back(policy, new WorkStealingPool(shared_size, policy));
+	return *pools->back().second;
+}
+
+/**
+ * @brief Sets the number of workers of shared pools started from now on; 0 restores the default.
+ */
+void WorkStealingPool::SetSharedSize(size_t threads) {
+	std::lock_guard<std::mutex> lock(registry_mutex);
+	shared_size = threads;
+}
+
+void WorkStealingPool::WorkerLoop(size_t index) {
+	if (!policy_.is_default() && !policy_.ApplyToCurrentThread()) {
+		LOGE("Worker thread policy was only partly applied");
+	}
+	current_pool = this;
+	current_worker = index;
+	Task task;
+	while (true) {
+		if (TakeTask(index, &task)) {
+			Run(task);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(sleep_mutex_);
+		if (stop_ && queued_.load(std::memory_order_acquire) == 0) {
+			return;
+		}
+		++sleepers_;
+		wakeup_.wait(lock, [this]() {
+			return stop_ || queued_.load(std::memory_order_acquire) != 0;
+		});
+		--sleepers_;
+	}
+}
+
+/**
+ * @brief Takes the newest task of worker `index`, else the oldest injected task, else steals the
+ * oldest task of another worker. An `index` past the last worker skips the first step.
+ */
+bool WorkStealingPool::TakeTask(size_t index, Task* task) {
+	if (queued_.load(std::memory_order_acquire) == 0) {
+		return false;
+	}
+	const size_t count = workers_.size();
+	if (index < count) {
+		Worker& own = *workers_[index];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.tasks.empty()) {
+			*task = std::move(own.tasks.back());
+			own.tasks.pop_back();
+			queued_.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+	if (PopInjected(task)) {
+		return true;
+	}
+	for (size_t i = 1; i <= count; ++i) {
+		Worker& victim = *workers_[(index + i) % count];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.tasks.empty()) {
+			*task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+			queued_.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+	return false;
+}
+
+bool WorkStealingPool::PopInjected(Task* task) {
+	std::lock_guard<std::mutex> lock(injection_mutex_);
+	if (injected_.empty()) {
+		return false;
+	}
+	*task = std::move(injected_.front());
+	injected_.pop_front();
+	queued_.fetch_sub(1, std::memory_order_relaxed);
+	return true;
+}
+
+/**
+ * @brief Runs `task` and releases it. A task that throws is logged rather than allowed to end
+ * the worker; use a TaskGroup to get the exception back.
+ */
+void WorkStealingPool::Run(Task& task) {
+	try {
+		task();
+	} catch (const std::exception& e) {
+		LOGE("Worker task threw: " << e.what());
+	} catch (...) {
+		LOGE("Worker task threw");
+	}
+	task = nullptr;
+}
+
+void WorkStealingPool::Wake() {
+	std::lock_guard<std::mutex> lock(sleep_mutex_);
+	if (sleepers_ != 0) {
+		wakeup_.notify_one();
+	}
+}
+
+TaskGroup::~TaskGroup() {
+	try {
+		Wait();
+	} catch (...) {
+	}
+}
+
+/**
+ * @brief Forks `task` on the group's executor.
+ */
+void TaskGroup::Run(std::function<void()> task) {
+	{
+		std::lock_guard<std::mutex> lock(state_->mutex);
+		++state_->pending;
+	}
+	executor_.Submit([state = state_, task = std::move(task)]() {
+		std::exception_ptr error;
+		try {
+			task();
+		} catch (...) {
+			error = std::current_exception();
+		}
+		std::lock_guard<std::mutex> lock(state->mutex);
+		if (error && !state->error) {
+			state->error = error;
+		}
+		if (--state->pending == 0) {
+			state->done.notify_all();
+		}
+	});
+}
+
+/**
+ * @brief Joins every task forked so far, running queued work meanwhile.
+ *
+ * Tasks that are neither queued nor visible to this thread (stolen, or on a host executor that
+ * cannot lend work) are waited for in short sleeps, so helping resumes when new work appears.
+ */
+void TaskGroup::Wait() {
+	while (true) {
+		{
+			std::lock_guard<std::mutex> lock(state_->mutex);
+			if (state_->pending == 0) {
+				break;
+			}
+		}
+		if (!executor_.RunPendingTask()) {
+			std::unique_lock<std::mutex> lock(state_->mutex);
+			state_->done.wait_for(lock, kHelpInterval, [this]() { return state_->pending == 0; });
+		}
+	}
+	std::lock_guard<std::mutex> lock(state_->mutex);
+	if (state_->error) {
+		std::rethrow_exception(std::exchange(state_->error, nullptr));
+	}
+}
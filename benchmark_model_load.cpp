@@ -0,0 +1,130 @@
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "TFLiteModelProtector/include/model_protector.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double ElapsedMs(Clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+struct PolicyCase {
+	const char* name;
+	BufferPolicy policy;
+	bool prefault;
+};
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+	std::vector<std::string> positional;
+	std::string trace_file;
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		if (arg == "--trace" && i + 1 < argc) {
+			trace_file = argv[++i];
+		} else {
+			positional.push_back(arg);
+		}
+	}
+	if (positional.empty() || positional.size() > 2) {
+		std::cerr << "Usage: " << argv[0]
+				  << " <tflite_model_file> [iterations] [--trace <json_file>]" << std::endl;
+		return 1;
+	}
+
+	const std::string input_file = positional[0];
+	const int iterations = positional.size() == 2 ? std::stoi(positional[1]) : 50;
+	if (!trace_file.empty()) {
+		TraceRecorder::Instance().Start();
+	}
+	const std::string encrypted_file =
+		(fs::temp_directory_path() / (fs::path(input_file).stem().string() + ".bench.enc"))
+			.string();
+
+	TFLiteModelProtector model_protector;
+	std::vector<uint8_t> key(TFLiteModelProtector::kAesKeyLength);
+	std::vector<uint8_t> iv(TFLiteModelProtector::kAesIvLength);
+	model_protector.GenerateKeyAndIv(key, iv);
+	model_protector.SetCustomKeyAndIv(key, iv);
+
+	if (!model_protector.EncryptFile(input_file, encrypted_file)) {
+		std::cerr << "Encryption failed!" << std::endl;
+		return 1;
+	}
+
+	const PolicyCase cases[] = {
+		{"heap", BufferPolicy::kHeap, false},
+		{"heap+prefault", BufferPolicy::kHeap, true},
+		{"thp", BufferPolicy::kTransparentHugePages, false},
+		{"thp+prefault", BufferPolicy::kTransparentHugePages, true},
+		{"hugetlbfs+prefault", BufferPolicy::kHugeTlbFs, true},
+	};
+
+	std::cout << "AES path: " << AesPathName(CpuFeatures::Get().aes_path) << std::endl;
+	std::cout << std::left << std::setw(20) << "policy" << std::right << std::setw(14)
+			  << "decrypt ms" << std::setw(14) << "build ms" << std::setw(16) << "first run ms"
+			  << std::setw(16) << "mean run ms" << std::endl;
+
+	for (const PolicyCase& c : cases) {
+		model_protector.SetBufferPolicy(c.policy, c.prefault);
+
+		ModelBuffer buffer;
+		auto start = Clock::now();
+		if (!model_protector.DecryptFileToMemory(encrypted_file, buffer)) {
+			std::cerr << "Decryption failed for policy " << c.name << std::endl;
+			continue;
+		}
+		const double decrypt_ms = ElapsedMs(start);
+
+		start = Clock::now();
+		auto model = model_protector.LoadModel(buffer);
+		tflite::ops::builtin::BuiltinOpResolver resolver;
+		std::unique_ptr<tflite::Interpreter> interpreter;
+		TfLiteStatus status = kTfLiteError;
+		if (model) {
+			ScopedTrace trace("InterpreterBuilder");
+			status = tflite::InterpreterBuilder(*model, resolver)(&interpreter);
+		}
+		if (status == kTfLiteOk) {
+			ScopedTrace trace("AllocateTensors");
+			status = interpreter->AllocateTensors();
+		}
+		if (status != kTfLiteOk) {
+			std::cerr << "Failed to build interpreter for policy " << c.name << std::endl;
+			continue;
+		}
+		const double build_ms = ElapsedMs(start);
+
+		start = Clock::now();
+		interpreter->Invoke();
+		const double first_ms = ElapsedMs(start);
+
+		start = Clock::now();
+		for (int i = 0; i < iterations; ++i) {
+			interpreter->Invoke();
+		}
+		const double mean_ms = iterations > 0 ? ElapsedMs(start) / iterations : 0.0;
+
+		std::cout << std::left << std::setw(20) << c.name << std::right << std::fixed
+				  << std::setprecision(3) << std::setw(14) << decrypt_ms << std::setw(14)
+				  << build_ms << std::setw(16) << first_ms << std::setw(16) << mean_ms
+				  << std::endl;
+	}
+
+	fs::remove(encrypted_file);
+	if (!trace_file.empty() && !TraceRecorder::Instance().WriteJson(trace_file)) {
+		std::cerr << "Failed to write trace to " << trace_file << std::endl;
+		return 1;
+	}
+	return 0;
+}
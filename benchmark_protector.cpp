@@ -0,0 +1,155 @@
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "TFLiteModelProtector/include/model_protector.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const size_t kSyntheticSizes[] = {64 << 10, 1 << 20, 16 << 20};
+
+double ElapsedMs(Clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+/**
+ * @brief Runs `op` `iterations` times and prints the mean time and throughput for `bytes`.
+ *
+ * @return false as soon as one run fails.
+ */
+bool Measure(const std::string& name, const std::string& input, size_t bytes, int iterations,
+			 const std::function<bool()>& op) {
+	double total_ms = 0;
+	for (int i = 0; i < iterations; ++i) {
+		const auto start = Clock::now();
+		if (!op()) {
+			std::cerr << name << " failed for " << input << " ("
+					  << ProtectorStatusName(TFLiteModelProtector::LastStatus()) << ")"
+					  << std::endl;
+			return false;
+		}
+		total_ms += ElapsedMs(start);
+	}
+	const double mean_ms = total_ms / iterations;
+	std::cout << std::left << std::setw(24) << name << std::setw(24) << input << std::right
+			  << std::setw(12) << std::fixed << std::setprecision(3) << mean_ms << std::setw(12)
+			  << std::setprecision(1) << (static_cast<double>(bytes) / 1e6) / (mean_ms / 1e3)
+			  << std::endl;
+	return true;
+}
+
+/**
+ * @brief Benchmarks encryption and every decryption entry point for one plaintext file.
+ *
+ * With `load` set the file must be a real TFLite model, and model loading is measured too.
+ */
+bool RunSuite(TFLiteModelProtector& protector, const std::string& plain_file,
+			  const std::string& label, int iterations, bool load) {
+	const size_t size = static_cast<size_t>(fs::file_size(plain_file));
+	const std::string base = (fs::temp_directory_path() / fs::path(plain_file).stem()).string();
+	bool ok = true;
+
+	for (const bool chunked : {false, true}) {
+		const std::string layout = chunked ? "chunked" : "stream";
+		const std::string encrypted_file = base + ".bench." + layout + ".enc";
+		protector.SetChunkedFormat(chunked);
+		ok = ok && Measure("encrypt/" + layout, label, size, iterations, [&]() {
+				 return protector.EncryptFile(plain_file, encrypted_file);
+			 });
+
+		ok = ok && Measure("decrypt-vector/" + layout, label, size, iterations, [&]() {
+				 std::vector<char> model;
+				 return protector.DecryptFileToMemory(encrypted_file, model);
+			 });
+		ok = ok && Measure("decrypt-buffer/" + layout, label, size, iterations, [&]() {
+				 ModelBuffer model;
+				 return protector.DecryptFileToMemory(encrypted_file, model);
+			 });
+
+		std::ifstream in(encrypted_file, std::ios::binary);
+		const std::vector<char> ciphertext((std::istreambuf_iterator<char>(in)), {});
+		ok = ok && Measure("decrypt-memory/" + layout, label, size, iterations, [&]() {
+				 std::vector<char> model;
+				 return protector.DecryptBufferToMemory(ciphertext.data(), ciphertext.size(),
+														model);
+			 });
+
+		if (load) {
+			ok = ok && Measure("load/" + layout, label, size, iterations, [&]() {
+					 return static_cast<bool>(protector.LoadDecryptedModel(encrypted_file));
+				 });
+		}
+		std::remove(encrypted_file.c_str());
+	}
+	return ok;
+}
+
+}  // namespace
+
+/**
+ * @brief Encrypt, decrypt and load benchmarks across model sizes.
+ *
+ * Synthetic payloads of several sizes exercise encryption and decryption; real models given on
+ * the command line are also loaded. This is the training workload of the PGO build (see
+ * TFLITE_PROTECTOR_PGO), so it covers every hot path of the library.
+ */
+int main(int argc, char* argv[]) {
+	int iterations = 5;
+	std::vector<std::string> models;
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		if (arg == "-n" && i + 1 < argc) {
+			iterations = std::stoi(argv[++i]);
+		} else if (!arg.empty() && arg[0] == '-') {
+			std::cerr << "Usage: " << argv[0] << " [-n <iterations>] [<tflite_model_file>...]"
+					  << std::endl;
+			return 1;
+		} else {
+			models.push_back(arg);
+		}
+	}
+
+	TFLiteModelProtector protector;
+	std::vector<uint8_t> key(TFLiteModelProtector::kAesKeyLength);
+	std::vector<uint8_t> iv(TFLiteModelProtector::kAesIvLength);
+	protector.GenerateKeyAndIv(key, iv);
+	protector.SetCustomKeyAndIv(key, iv);
+
+	std::cout << "AES path: " << AesPathName(CpuFeatures::Get().aes_path) << std::endl;
+	std::cout << std::left << std::setw(24) << "operation" << std::setw(24) << "input"
+			  << std::right << std::setw(12) << "mean ms" << std::setw(12) << "MB/s" << std::endl;
+
+	bool ok = true;
+	std::mt19937_64 rng(42);
+	for (const size_t size : kSyntheticSizes) {
+		const std::string plain_file =
+			(fs::temp_directory_path() / ("synthetic_" + std::to_string(size) + ".bin")).string();
+		{
+			std::vector<uint64_t> words(size / sizeof(uint64_t));
+			for (uint64_t& word : words) {
+				word = rng();
+			}
+			std::ofstream out(plain_file, std::ios::binary | std::ios::trunc);
+			out.write(reinterpret_cast<const char*>(words.data()),
+					  static_cast<std::streamsize>(size));
+		}
+		ok = RunSuite(protector, plain_file, std::to_string(size >> 10) + " KiB", iterations,
+					  false) &&
+			 ok;
+		std::remove(plain_file.c_str());
+	}
+	for (const std::string& model : models) {
+		const std::string label = fs::path(model).filename().string();
+		ok = RunSuite(protector, model, label, iterations, true) && ok;
+	}
+	return ok ? 0 : 1;
+}
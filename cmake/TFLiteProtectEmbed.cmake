@@ -0,0 +1,65 @@
+# tflite_protect_embed(<target> <model.tflite> KEY <hex> IV <hex> [NAME <symbol>] [CHUNKED])
+#
+# Encrypts <model.tflite> with encrypt_model at build time and links the ciphertext into
+# <target>'s .rodata as the 64-byte aligned symbol <symbol>, with its size in <symbol>_size.
+# <symbol> defaults to the model's file name followed by "_model". In the sources:
+#
+#   TFLITE_DECLARE_EMBEDDED_MODEL(detector_model);
+#   auto model = protector.LoadEmbeddedModel(TFLITE_EMBEDDED_MODEL(detector_model));
+#
+# The object is generated as C++ with a top-level .incbin, so the target needs no ASM language.
+function(tflite_protect_embed target model)
+    cmake_parse_arguments(EMBED "CHUNKED" "NAME;KEY;IV" "" ${ARGN})
+    if(NOT EMBED_KEY OR NOT EMBED_IV)
+        message(FATAL_ERROR "tflite_protect_embed(${target} ${model}): KEY and IV are required")
+    endif()
+    get_filename_component(model_path "${model}" ABSOLUTE)
+    if(NOT EMBED_NAME)
+        get_filename_component(model_stem "${model}" NAME_WE)
+        string(MAKE_C_IDENTIFIER "${model_stem}_model" EMBED_NAME)
+    endif()
+
+    set(embed_dir "${CMAKE_CURRENT_BINARY_DIR}/tflite_embed")
+    set(encrypted "${embed_dir}/${EMBED_NAME}.enc")
+    set(source "${embed_dir}/${EMBED_NAME}.cpp")
+    set(chunked_flag)
+    if(EMBED_CHUNKED)
+        set(chunked_flag --chunked)
+    endif()
+
+    add_custom_command(
+            OUTPUT "${encrypted}"
+            COMMAND ${CMAKE_COMMAND} -E make_directory "${embed_dir}"
+            COMMAND encrypt_model --key ${EMBED_KEY} --iv ${EMBED_IV} ${chunked_flag}
+                    -o "${encrypted}" "${model_path}"
+            DEPENDS "${model_path}" encrypt_model
+            COMMENT "Encrypting ${model} for embedding as ${EMBED_NAME}"
+            VERBATIM
+    )
+
+    set(EMBED_FILE "${encrypted}")
+    file(CONFIGURE OUTPUT "${source}" CONTENT [=[
+// Generated by tflite_protect_embed() from @model_path@. Do not edit.
+__asm__(
+    ".pushsection .rodata.@EMBED_NAME@, \"a\", %progbits\n"
+    ".balign 64\n"
+    ".globl @EMBED_NAME@\n"
+    ".type @EMBED_NAME@, %object\n"
+    "@EMBED_NAME@:\n"
+    ".incbin \"@EMBED_FILE@\"\n"
+    ".L@EMBED_NAME@_end:\n"
+    ".size @EMBED_NAME@, .L@EMBED_NAME@_end - @EMBED_NAME@\n"
+    ".balign 8\n"
+    ".globl @EMBED_NAME@_size\n"
+    ".type @EMBED_NAME@_size, %object\n"
+    "@EMBED_NAME@_size:\n"
+    ".quad .L@EMBED_NAME@_end - @EMBED_NAME@\n"
+    ".size @EMBED_NAME@_size, 8\n"
+    ".popsection\n");
+]=] @ONLY)
+
+    # .incbin is invisible to dependency scanning, so rebuild the object when the ciphertext
+    # changes.
+    set_source_files_properties("${source}" PROPERTIES OBJECT_DEPENDS "${encrypted}")
+    target_sources(${target} PRIVATE "${source}" "${encrypted}")
+endfunction()
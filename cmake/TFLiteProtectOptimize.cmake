@@ -0,0 +1,58 @@
+# Build options for the protector library and its tools:
+#
+#   TFLITE_PROTECTOR_STATIC      Build TFLiteModelProtector as a static library, so executables
+#                                call into it directly rather than through the PLT.
+#   TFLITE_PROTECTOR_LTO         Link-time optimization.
+#   TFLITE_PROTECTOR_PGO         OFF, GENERATE (instrumented build) or USE (optimize with the
+#                                profiles in TFLITE_PROTECTOR_PGO_DIR).
+#   TFLITE_PROTECTOR_PGO_MODELS  Real .tflite models the training run also loads.
+#
+# The pgo target runs the whole cycle in <build>/pgo; see "Optimized Builds" in the README.
+option(TFLITE_PROTECTOR_STATIC "Build TFLiteModelProtector as a static library" OFF)
+option(TFLITE_PROTECTOR_LTO "Build the library and tools with link-time optimization" OFF)
+set(TFLITE_PROTECTOR_PGO OFF CACHE STRING "Profile-guided optimization: OFF, GENERATE or USE")
+set_property(CACHE TFLITE_PROTECTOR_PGO PROPERTY STRINGS OFF GENERATE USE)
+set(TFLITE_PROTECTOR_PGO_DIR "${CMAKE_BINARY_DIR}/pgo-profiles" CACHE PATH
+    "Directory PGO profiles are written to and read from")
+set(TFLITE_PROTECTOR_PGO_MODELS "" CACHE STRING "Models loaded by the PGO training run")
+
+if(TFLITE_PROTECTOR_LTO)
+    include(CheckIPOSupported)
+    check_ipo_supported(RESULT lto_supported OUTPUT lto_output LANGUAGES CXX)
+    if(NOT lto_supported)
+        message(FATAL_ERROR
+            "TFLITE_PROTECTOR_LTO is not supported by this toolchain: ${lto_output}")
+    endif()
+endif()
+
+if(NOT TFLITE_PROTECTOR_PGO MATCHES "^(OFF|GENERATE|USE)$")
+    message(FATAL_ERROR "TFLITE_PROTECTOR_PGO must be OFF, GENERATE or USE")
+endif()
+
+# GCC keys its .gcda files by object path, so GENERATE and USE must share a build tree. Clang
+# merges its raw profiles into one file that any tree can use.
+if(CMAKE_CXX_COMPILER_ID MATCHES "Clang")
+    find_program(TFLITE_PROTECTOR_LLVM_PROFDATA llvm-profdata)
+    set(TFLITE_PROTECTOR_PGO_USE_FLAGS
+        "-fprofile-use=${TFLITE_PROTECTOR_PGO_DIR}/default.profdata" -Wno-profile-instr-unprofiled)
+else()
+    set(TFLITE_PROTECTOR_PGO_USE_FLAGS
+        "-fprofile-use=${TFLITE_PROTECTOR_PGO_DIR}" -fprofile-partial-training -Wno-missing-profile)
+endif()
+
+# tflite_protector_optimize(<target>) applies the LTO and PGO options to <target>.
+function(tflite_protector_optimize target)
+    if(TFLITE_PROTECTOR_LTO)
+        set_property(TARGET ${target} PROPERTY INTERPROCEDURAL_OPTIMIZATION ON)
+    endif()
+    if(TFLITE_PROTECTOR_PGO STREQUAL "GENERATE")
+        # Atomic counters, because decryption and re-encryption run on several threads.
+        set(flags "-fprofile-generate=${TFLITE_PROTECTOR_PGO_DIR}" -fprofile-update=atomic)
+    elseif(TFLITE_PROTECTOR_PGO STREQUAL "USE")
+        set(flags ${TFLITE_PROTECTOR_PGO_USE_FLAGS})
+    endif()
+    if(flags)
+        target_compile_options(${target} PRIVATE ${flags})
+        target_link_options(${target} PRIVATE ${flags})
+    endif()
+endfunction()
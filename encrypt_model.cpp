@@ -1,27 +1,260 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <tensorflow/lite/schema/schema_generated.h>
+#include <unistd.h>
+
 #include <filesystem>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 #include <vector>
 
 #include "TFLiteModelProtector/include/model_protector.hpp"
 
 namespace fs = std::filesystem;
 
+/**
+ * @brief Runs the TFLite FlatBuffer verifier over a model file.
+ *
+ * The file is mapped read-only instead of being read into memory. Once VerifyEncryptedFile() has
+ * shown that the encrypted artifact decrypts to exactly these bytes, verifying the original is
+ * equivalent to verifying the reconstructed model.
+ */
+static bool VerifyFlatBuffer(const std::string& model_file) {
+	const int fd = open(model_file.c_str(), O_RDONLY);
+	struct stat st = {};
+	if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0) {
+		if (fd >= 0) {
+			close(fd);
+		}
+		return false;
+	}
+	const size_t size = static_cast<size_t>(st.st_size);
+	void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		return false;
+	}
+	madvise(data, size, MADV_SEQUENTIAL);
+
+	flatbuffers::Verifier verifier(static_cast<const uint8_t*>(data), size);
+	const bool ok = tflite::VerifyModelBuffer(verifier);
+	munmap(data, size);
+	return ok;
+}
+
+/**
+ * @brief Parses a hex string such as "0a1b..." into exactly `length` bytes.
+ */
+static bool ParseHex(const std::string& hex, size_t length, std::vector<uint8_t>& bytes) {
+	if (hex.size() != 2 * length) {
+		return false;
+	}
+	bytes.resize(length);
+	for (size_t i = 0; i < length; ++i) {
+		const std::string byte = hex.substr(2 * i, 2);
+		if (byte.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos) {
+			return false;
+		}
+		bytes[i] = static_cast<uint8_t>(std::stoul(byte, nullptr, 16));
+	}
+	return true;
+}
+
+/**
+ * @brief Formats bytes as zero-padded hex, the form ParseHex() accepts.
+ */
+static std::string FormatHex(const std::vector<uint8_t>& bytes) {
+	std::ostringstream hex;
+	hex << std::hex << std::setfill('0');
+	for (const uint8_t byte : bytes) {
+		hex << std::setw(2) << static_cast<int>(byte);
+	}
+	return hex.str();
+}
+
+/**
+ * @brief `encrypt_model rekey`: rotates encrypted models to a new key in place.
+ *
+ * Plaintext is never written to disk; every file is streamed through ReEncrypt() and several
+ * files are processed in parallel.
+ */
+static int RunRekey(int argc, char* argv[]) {
+	const std::string usage =
+		"Usage: encrypt_model rekey --old-key <hex> --old-iv <hex> [--new-key <hex> --new-iv "
+		"<hex>] [-j <threads>] <encrypted_file>...";
+	std::string old_key_hex, old_iv_hex, new_key_hex, new_iv_hex;
+	size_t parallelism = 0;
+	std::vector<std::string> files;
+
+	for (int i = 0; i < argc; ++i) {
+		const std::string arg = argv[i];
+		const bool has_value = i + 1 < argc;
+		if (arg == "--old-key" && has_value) {
+			old_key_hex = argv[++i];
+		} else if (arg == "--old-iv" && has_value) {
+			old_iv_hex = argv[++i];
+		} else if (arg == "--new-key" && has_value) {
+			new_key_hex = argv[++i];
+		} else if (arg == "--new-iv" && has_value) {
+			new_iv_hex = argv[++i];
+		} else if (arg == "-j" && has_value) {
+			const std::string threads = argv[++i];
+			if (threads.empty() || threads.size() > 4 ||
+				threads.find_first_not_of("0123456789") != std::string::npos) {
+				std::cerr << usage << std::endl;
+				return 1;
+			}
+			parallelism = std::stoul(threads);
+		} else {
+			files.push_back(arg);
+		}
+	}
+
+	TFLiteModelProtector model_protector;
+	std::vector<uint8_t> old_key, old_iv;
+	std::vector<uint8_t> new_key(TFLiteModelProtector::kAesKeyLength);
+	std::vector<uint8_t> new_iv(TFLiteModelProtector::kAesIvLength);
+
+	if (files.empty() || !ParseHex(old_key_hex, TFLiteModelProtector::kAesKeyLength, old_key) ||
+		!ParseHex(old_iv_hex, TFLiteModelProtector::kAesIvLength, old_iv)) {
+		std::cerr << usage << std::endl;
+		return 1;
+	}
+	const bool generated = new_key_hex.empty() && new_iv_hex.empty();
+	if (generated) {
+		model_protector.GenerateKeyAndIv(new_key, new_iv);
+	} else if (!ParseHex(new_key_hex, TFLiteModelProtector::kAesKeyLength, new_key) ||
+			   !ParseHex(new_iv_hex, TFLiteModelProtector::kAesIvLength, new_iv)) {
+		std::cerr << usage << std::endl;
+		return 1;
+	}
+
+	model_protector.SetCustomKeyAndIv(old_key, old_iv);
+	const size_t failures = model_protector.ReEncryptFiles(files, new_key, new_iv, parallelism);
+	if (generated) {
+		// Printed even if some files failed: the others already use the new key.
+		std::cout << "New key: " << FormatHex(new_key) << std::endl;
+		std::cout << "New IV: " << FormatHex(new_iv) << std::endl;
+	}
+	if (failures > 0) {
+		std::cerr << "Re-encryption failed for " << failures << " of " << files.size()
+				  << " files!" << std::endl;
+		return 1;
+	}
+
+	std::cout << "Re-encrypted " << files.size() << " files." << std::endl;
+	return 0;
+}
+
+/**
+ * @brief `encrypt_model diff`: writes the chunks of a new chunked model that differ from the old.
+ *
+ * Only ciphertext is compared, so this runs on a build server without the key.
+ */
+static int RunDiff(int argc, char* argv[]) {
+	if (argc != 3) {
+		std::cerr << "Usage: encrypt_model diff <old.enc> <new.enc> <out.delta>" << std::endl;
+		return 1;
+	}
+	size_t changed_chunks = 0;
+	if (!TFLiteModelProtector::CreateDelta(argv[0], argv[1], argv[2], &changed_chunks)) {
+		std::cerr << "Diff failed!" << std::endl;
+		return 1;
+	}
+	std::cout << "Delta with " << changed_chunks << " changed chunks saved as: " << argv[2]
+			  << std::endl;
+	return 0;
+}
+
+/**
+ * @brief `encrypt_model patch`: rebuilds the new encrypted model from the old one and a delta.
+ */
+static int RunPatch(int argc, char* argv[]) {
+	if (argc != 3) {
+		std::cerr << "Usage: encrypt_model patch <old.enc> <in.delta> <new.enc>" << std::endl;
+		return 1;
+	}
+	if (!TFLiteModelProtector::PatchEncryptedFile(argv[0], argv[1], argv[2])) {
+		std::cerr << "Patch failed!" << std::endl;
+		return 1;
+	}
+	std::cout << "Patched model saved as: " << argv[2] << std::endl;
+	return 0;
+}
+
 int main(int argc, char* argv[]) {
+	if (argc >= 2 && std::string(argv[1]) == "rekey") {
+		return RunRekey(argc - 2, argv + 2);
+	}
+	if (argc >= 2 && std::string(argv[1]) == "diff") {
+		return RunDiff(argc - 2, argv + 2);
+	}
+	if (argc >= 2 && std::string(argv[1]) == "patch") {
+		return RunPatch(argc - 2, argv + 2);
+	}
+
 	TFLiteModelProtector model_protector;
-	if (argc != 2) {
-		std::cerr << "Usage: " << argv[0] << " <tflite_model_file>" << std::endl;
+	bool verify = false;
+	std::string input_file;
+	std::string encrypted_file;
+	std::string key_hex, iv_hex;
+
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		const bool has_value = i + 1 < argc;
+		if (arg == "--verify") {
+			verify = true;
+		} else if (arg == "--chunked") {
+			model_protector.SetChunkedFormat(true);
+		} else if (arg == "--key" && has_value) {
+			key_hex = argv[++i];
+		} else if (arg == "--iv" && has_value) {
+			iv_hex = argv[++i];
+		} else if (arg == "-o" && has_value) {
+			encrypted_file = argv[++i];
+		} else if (input_file.empty()) {
+			input_file = arg;
+		} else {
+			input_file.clear();
+			break;
+		}
+	}
+
+	if (input_file.empty()) {
+		std::cerr << "Usage: " << argv[0]
+				  << " [--verify] [--chunked] [--key <hex> --iv <hex>] [-o <output>] "
+					 "<tflite_model_file>"
+				  << std::endl;
+		std::cerr << "       " << argv[0] << " rekey --help" << std::endl;
+		std::cerr << "       " << argv[0] << " diff <old.enc> <new.enc> <out.delta>" << std::endl;
+		std::cerr << "       " << argv[0] << " patch <old.enc> <in.delta> <new.enc>" << std::endl;
 		return 1;
 	}
 
-	std::string input_file = argv[1];
-	std::string filename = input_file.substr(0, input_file.find_last_of("."));
-	std::string encrypted_file = filename + ".enc";
+	if (encrypted_file.empty()) {
+		std::string filename = input_file.substr(0, input_file.find_last_of("."));
+		encrypted_file = filename + ".enc";
+	}
 
 	std::vector<uint8_t> key(TFLiteModelProtector::kAesKeyLength);
 	std::vector<uint8_t> iv(TFLiteModelProtector::kAesIvLength);
 
-	model_protector.GenerateKeyAndIv(key, iv);
+	if (key_hex.empty() && iv_hex.empty()) {
+		model_protector.GenerateKeyAndIv(key, iv);
+		model_protector.SetCustomKeyAndIv(key, iv);
+		std::cout << "Generated key: " << FormatHex(key) << std::endl;
+		std::cout << "Generated IV: " << FormatHex(iv) << std::endl;
+	} else if (ParseHex(key_hex, TFLiteModelProtector::kAesKeyLength, key) &&
+			   ParseHex(iv_hex, TFLiteModelProtector::kAesIvLength, iv)) {
+		model_protector.SetCustomKeyAndIv(key, iv);
+	} else {
+		std::cerr << "--key needs " << 2 * TFLiteModelProtector::kAesKeyLength
+				  << " hex digits and --iv " << 2 * TFLiteModelProtector::kAesIvLength << std::endl;
+		return 1;
+	}
 
 	if (!model_protector.EncryptFile(input_file, encrypted_file)) {
 		std::cerr << "Encryption failed!" << std::endl;
@@ -31,5 +264,17 @@ int main(int argc, char* argv[]) {
 	std::cout << "Encryption successful!" << std::endl;
 	std::cout << "Encrypted model saved as: " << encrypted_file << std::endl;
 
+	if (verify) {
+		if (!model_protector.VerifyEncryptedFile(input_file, encrypted_file)) {
+			std::cerr << "Verification failed: encrypted model does not round-trip!" << std::endl;
+			return 1;
+		}
+		if (!VerifyFlatBuffer(input_file)) {
+			std::cerr << "Verification failed: not a valid TFLite FlatBuffer!" << std::endl;
+			return 1;
+		}
+		std::cout << "Verification successful!" << std::endl;
+	}
+
 	return 0;
 }
@@ -0,0 +1,435 @@
+#include <sys/stat.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "model_cache.hpp"
+#include "test_support.hpp"
+
+/**
+ * Threaded regression tests: single-flight loads and joins that give up, loads that give up on
+ * the load lock, content deduplication, the model cache, nested TaskGroup fork/join, and
+ * cancellation, deadlines and progress.
+ *
+ * Overlap between threads is forced where a check depends on it: the leading load blocks in its
+ * progress callback until the other threads are waiting.
+ */
+
+namespace fs = std::filesystem;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const std::vector<uint8_t> kKey(TFLiteModelProtector::kAesKeyLength, 0x31);
+const std::vector<uint8_t> kIv(TFLiteModelProtector::kAesIvLength, 0x42);
+
+std::string dir;
+
+std::string Path(const char* name) { return dir + "/" + name; }
+
+bool Exists(const std::string& path) {
+	struct stat st = {};
+	return stat(path.c_str(), &st) == 0;
+}
+
+// Reads one sample, e.g. `tflite_protector_cache_hits_total{cache="single_flight"}`.
+uint64_t Metric(const std::string& series) {
+	const std::string text = ProtectorMetrics::Instance().Render();
+	const size_t at = text.find("\n" + series + " ");
+	return at == std::string::npos ? 0 : std::stoull(text.substr(at + series.size() + 2));
+}
+
+const std::string kDecryptedBytes = "tflite_protector_decrypted_bytes_total";
+const std::string kSingleFlightHits = "tflite_protector_cache_hits_total{cache=\"single_flight\"}";
+const std::string kLockWaits = "tflite_protector_lock_wait_seconds_count";
+
+// Blocks until `ready` holds, for at most a few seconds so a broken test fails instead of hanging.
+template <typename Ready>
+bool WaitFor(Ready ready) {
+	const Clock::time_point give_up = Clock::now() + std::chrono::seconds(10);
+	while (!ready()) {
+		if (Clock::now() > give_up) {
+			return false;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return true;
+}
+
+// N threads loading one path concurrently decrypt it once and share the result.
+void TestSingleFlight(TFLiteModelProtector& protector, std::mt19937& rng) {
+	constexpr int kThreads = 8;
+	const std::vector<char> data = RandomBytes(rng, 4 * TFLiteModelProtector::kIoChunkSize);
+	WriteAll(Path("shared.bin"), data);
+	CHECK(protector.EncryptFile(Path("shared.bin"), Path("shared.enc")));
+	// Pointer equality must come from the join, not from deduplication.
+	protector.SetDeduplicateModels(false);
+
+	// Only the leader decrypts, so only its progress callback runs. It holds the load until
+	// every thread has reached LoadSharedModel(), plus a margin for them to join.
+	std::atomic<int> arrived{0};
+	std::atomic<bool> held{false};
+	OperationControl control;
+	control.progress = [&](uint64_t, uint64_t) {
+		if (!held.exchange(true)) {
+			WaitFor([&]() { return arrived.load() == kThreads; });
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		}
+	};
+
+	const uint64_t decrypted_before = Metric(kDecryptedBytes);
+	const uint64_t joins_before = Metric(kSingleFlightHits);
+	std::vector<std::shared_ptr<const DecryptedModel>> models(kThreads);
+	std::vector<std::thread> threads;
+	for (int i = 0; i < kThreads; ++i) {
+		threads.emplace_back([&, i]() {
+			ScopedOperationControl scope(control);
+			++arrived;
+			models[i] = protector.LoadSharedModel(Path("shared.enc"));
+		});
+	}
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+
+	std::set<const DecryptedModel*> distinct;
+	for (const auto& model : models) {
+		CHECK(model && model->size() == data.size());
+		distinct.insert(model.get());
+	}
+	CHECK(distinct.size() == 1);
+	CHECK(models[0] && std::memcmp(models[0]->data(), data.data(), data.size()) == 0);
+	CHECK(Metric(kDecryptedBytes) - decrypted_before == data.size());
+	CHECK(Metric(kSingleFlightHits) - joins_before == kThreads - 1);
+	protector.SetDeduplicateModels(true);
+}
+
+// A joined caller whose own deadline passes gives up; the leader still finishes its load.
+void TestJoinGivesUp(TFLiteModelProtector& protector, std::mt19937& rng) {
+	const std::vector<char> data = RandomBytes(rng, 4 * TFLiteModelProtector::kIoChunkSize);
+	WriteAll(Path("slow.bin"), data);
+	CHECK(protector.EncryptFile(Path("slow.bin"), Path("slow.enc")));
+
+	std::atomic<bool> started{false};
+	std::atomic<bool> release{false};
+	OperationControl leader_control;
+	leader_control.progress = [&](uint64_t, uint64_t) {
+		started = true;
+		WaitFor([&]() { return release.load(); });
+	};
+	std::shared_ptr<const DecryptedModel> leader_model;
+	std::thread leader([&]() {
+		ScopedOperationControl scope(leader_control);
+		leader_model = protector.LoadSharedModel(Path("slow.enc"));
+	});
+	CHECK(WaitFor([&]() { return started.load(); }));
+
+	{
+		OperationControl control;
+		control.deadline = Clock::now() + std::chrono::milliseconds(50);
+		ScopedOperationControl scope(control);
+		const Clock::time_point start = Clock::now();
+		CHECK(!protector.LoadSharedModel(Path("slow.enc")));
+		CHECK_STATUS(kDeadlineExceeded);
+		CHECK(Clock::now() - start < std::chrono::seconds(2));
+	}
+	{
+		OperationControl control;
+		control.token.Cancel();
+		ScopedOperationControl scope(control);
+		CHECK(!protector.LoadSharedModel(Path("slow.enc")));
+		CHECK_STATUS(kCancelled);
+	}
+
+	release = true;
+	leader.join();
+	CHECK(leader_model && leader_model->size() == data.size());
+}
+
+// A load waiting for another protector's load to release the load lock gives up when its
+// deadline passes, and the wait is still recorded.
+void TestLoadLockGivesUp(std::mt19937& rng) {
+	const std::vector<char> data = RandomBytes(rng, 4 * TFLiteModelProtector::kIoChunkSize);
+	WriteAll(Path("locked.bin"), data);
+	TFLiteModelProtector holder;
+	holder.SetCustomKeyAndIv(kKey, kIv);
+	CHECK(holder.EncryptFile(Path("locked.bin"), Path("locked.enc")));
+
+	std::atomic<bool> started{false};
+	std::atomic<bool> release{false};
+	OperationControl holder_control;
+	holder_control.progress = [&](uint64_t, uint64_t) {
+		started = true;
+		WaitFor([&]() { return release.load(); });
+	};
+	std::thread loader([&]() {
+		ScopedOperationControl scope(holder_control);
+		holder.LoadEncryptedModel(Path("locked.enc"));
+	});
+	CHECK(WaitFor([&]() { return started.load(); }));
+
+	TFLiteModelProtector waiter;
+	waiter.SetCustomKeyAndIv(kKey, kIv);
+	const uint64_t waits = Metric(kLockWaits);
+	{
+		OperationControl control;
+		control.deadline = Clock::now() + std::chrono::milliseconds(50);
+		ScopedOperationControl scope(control);
+		const Clock::time_point start = Clock::now();
+		CHECK(!waiter.LoadEncryptedModel(Path("locked.enc")));
+		CHECK_STATUS(kDeadlineExceeded);
+		CHECK(Clock::now() - start < std::chrono::seconds(2));
+	}
+	CHECK(Metric(kLockWaits) == waits + 1);
+
+	release = true;
+	loader.join();
+}
+
+// Two paths with identical plaintext share one buffer, across keys; the table forgets the
+// model once its last holder releases it.
+void TestDeduplication(TFLiteModelProtector& protector, std::mt19937& rng) {
+	TFLiteModelProtector other;
+	other.SetCustomKeyAndIv(std::vector<uint8_t>(TFLiteModelProtector::kAesKeyLength, 0x77), kIv);
+	const std::vector<char> data = RandomBytes(rng, 300001);
+	std::vector<char> different = data;
+	different[1234] ^= 1;
+	WriteAll(Path("dedup.bin"), data);
+	WriteAll(Path("different.bin"), different);
+	CHECK(protector.EncryptFile(Path("dedup.bin"), Path("dedup_a.enc")));
+	CHECK(other.EncryptFile(Path("dedup.bin"), Path("dedup_b.enc")));
+	CHECK(protector.EncryptFile(Path("different.bin"), Path("different.enc")));
+
+	ModelDeduplicator& table = ModelDeduplicator::Instance();
+	const size_t entries_before = table.size();
+	std::shared_ptr<const DecryptedModel> a = protector.LoadSharedModel(Path("dedup_a.enc"));
+	std::shared_ptr<const DecryptedModel> b = other.LoadSharedModel(Path("dedup_b.enc"));
+	std::shared_ptr<const DecryptedModel> c = protector.LoadSharedModel(Path("different.enc"));
+	CHECK(a && a == b);
+	CHECK(c && c != a);
+	CHECK(table.size() == entries_before + 2);
+
+	// A load placed on a NUMA node only shares plaintext bound to that node.
+	protector.SetNumaNode(0);
+	std::shared_ptr<const DecryptedModel> placed = protector.LoadSharedModel(Path("dedup_a.enc"));
+	protector.SetNumaNode(-1);
+	CHECK(placed);
+	if (placed && placed->buffer().numa_node() == 0) {
+		CHECK(placed != a);
+	}
+	placed.reset();
+	CHECK(table.size() == entries_before + 2);
+
+	a.reset();
+	CHECK(table.size() == entries_before + 2);  // b still holds it
+	b.reset();
+	CHECK(table.size() == entries_before + 1);
+	c.reset();
+	CHECK(table.size() == entries_before);
+
+	// Concurrent loads of the two paths still end up on one buffer.
+	std::vector<std::shared_ptr<const DecryptedModel>> models(8);
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < models.size(); ++i) {
+		threads.emplace_back([&, i]() {
+			models[i] = i % 2 == 0 ? protector.LoadSharedModel(Path("dedup_a.enc"))
+								   : other.LoadSharedModel(Path("dedup_b.enc"));
+		});
+	}
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+	std::set<const DecryptedModel*> distinct;
+	for (const auto& model : models) {
+		CHECK(model);
+		distinct.insert(model.get());
+	}
+	CHECK(distinct.size() == 1);
+	models.clear();
+	CHECK(table.size() == entries_before);
+}
+
+// The cache evicts least recently used models beyond its capacity, counts a model shared by
+// two paths once, and reloads a model whose file changed.
+void TestModelCache(TFLiteModelProtector& protector, std::mt19937& rng) {
+	const size_t size = 200000;
+	const std::vector<char> first = RandomBytes(rng, size);
+	const std::vector<char> second = RandomBytes(rng, size);
+	WriteAll(Path("first.bin"), first);
+	WriteAll(Path("second.bin"), second);
+	CHECK(protector.EncryptFile(Path("first.bin"), Path("first.enc")));
+	CHECK(protector.EncryptFile(Path("first.bin"), Path("first_copy.enc")));
+	CHECK(protector.EncryptFile(Path("second.bin"), Path("second.enc")));
+
+	ModelCache cache(protector, size + size / 2);
+	std::shared_ptr<const DecryptedModel> model = cache.Get(Path("first.enc"));
+	CHECK(model && cache.Get(Path("first.enc")) == model);
+	CHECK(cache.Get(Path("first_copy.enc")) == model);
+	CHECK(cache.size() == 2 && cache.resident_bytes() == size);
+	model.reset();
+
+	// Over capacity: both entries for the first model go.
+	CHECK(cache.Get(Path("second.enc")));
+	CHECK(cache.size() == 1 && cache.resident_bytes() == size);
+
+	// A rewritten file is reloaded, not served from the cache.
+	std::shared_ptr<const DecryptedModel> old_model = cache.Get(Path("second.enc"));
+	CHECK(protector.EncryptFile(Path("first.bin"), Path("second.tmp")));
+	fs::rename(Path("second.tmp"), Path("second.enc"));
+	std::shared_ptr<const DecryptedModel> new_model = cache.Get(Path("second.enc"));
+	CHECK(new_model && new_model != old_model &&
+		  std::memcmp(new_model->data(), first.data(), size) == 0);
+	CHECK(old_model && std::memcmp(old_model->data(), second.data(), size) == 0);
+
+	cache.Clear();
+	CHECK(cache.size() == 0 && cache.resident_bytes() == 0);
+}
+
+// Tasks that fork and join their own groups run to completion on a small pool, and the first
+// exception reaches Wait().
+void TestNestedTaskGroups() {
+	WorkStealingPool pool(2);
+	std::atomic<int> leaves{0};
+	{
+		TaskGroup outer(pool);
+		for (int i = 0; i < 16; ++i) {
+			outer.Run([&]() {
+				TaskGroup inner(pool);
+				for (int j = 0; j < 16; ++j) {
+					inner.Run([&]() { ++leaves; });
+				}
+				inner.Wait();
+			});
+		}
+		outer.Wait();
+	}
+	CHECK(leaves.load() == 16 * 16);
+
+	TaskGroup group(pool);
+	group.Run([]() { throw std::runtime_error("task failed"); });
+	group.Run([&]() { ++leaves; });
+	bool thrown = false;
+	try {
+		group.Wait();
+	} catch (const std::runtime_error&) {
+		thrown = true;
+	}
+	CHECK(thrown && leaves.load() == 16 * 16 + 1);
+}
+
+// Cancellation and deadlines fail with their own status and leave no output behind; progress
+// runs from zero to the total.
+void TestOperationControl(TFLiteModelProtector& protector, std::mt19937& rng) {
+	const std::vector<char> data = RandomBytes(rng, 8 * TFLiteModelProtector::kIoChunkSize + 5);
+	WriteAll(Path("control.bin"), data);
+
+	{
+		OperationControl control;
+		uint64_t first = 1;
+		uint64_t last = 0;
+		uint64_t total = 0;
+		control.progress = [&](uint64_t done, uint64_t of) {
+			first = std::min(first, done);
+			last = done;
+			total = of;
+		};
+		ScopedOperationControl scope(control);
+		CHECK(protector.EncryptFile(Path("control.bin"), Path("control.enc")));
+		CHECK(first == 0 && last == data.size() && total == data.size());
+	}
+
+	// Cancelled from another thread once encryption is under way.
+	{
+		OperationControl control;
+		std::atomic<bool> started{false};
+		control.progress = [&](uint64_t done, uint64_t) {
+			if (done > 0) {
+				started = true;
+				std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			}
+		};
+		CancellationToken token = control.token;
+		std::thread canceller([&]() {
+			WaitFor([&]() { return started.load(); });
+			token.Cancel();
+		});
+		ScopedOperationControl scope(control);
+		CHECK(!protector.EncryptFile(Path("control.bin"), Path("cancelled.enc")));
+		CHECK_STATUS(kCancelled);
+		canceller.join();
+		CHECK(!Exists(Path("cancelled.enc")));
+	}
+
+	{
+		OperationControl control;
+		control.deadline = Clock::now();
+		ScopedOperationControl scope(control);
+		CHECK(!protector.EncryptFile(Path("control.bin"), Path("late.enc")));
+		CHECK_STATUS(kDeadlineExceeded);
+		CHECK(!Exists(Path("late.enc")));
+
+		const std::vector<uint8_t> new_key(TFLiteModelProtector::kAesKeyLength, 0x99);
+		CHECK(!protector.ReEncrypt(Path("control.enc"), Path("rekeyed.enc"), new_key, kIv));
+		CHECK_STATUS(kDeadlineExceeded);
+		CHECK(!Exists(Path("rekeyed.enc")));
+		CHECK(!protector.ReEncrypt(Path("control.enc"), Path("control.enc"), new_key, kIv));
+		std::vector<char> decrypted{'x'};
+		CHECK(!protector.DecryptFileToMemory(Path("control.enc"), decrypted) &&
+			  decrypted.size() == 1);
+		CHECK_STATUS(kDeadlineExceeded);
+	}
+
+	// Cancelled in-place rotation leaves the file on the old key and no temporary behind.
+	{
+		OperationControl control;
+		control.token.Cancel();
+		ScopedOperationControl scope(control);
+		const std::vector<uint8_t> new_key(TFLiteModelProtector::kAesKeyLength, 0x99);
+		CHECK(!protector.ReEncrypt(Path("control.enc"), Path("control.enc"), new_key, kIv));
+		CHECK_STATUS(kCancelled);
+	}
+	CHECK(Decrypts(protector, Path("control.enc"), data));
+	for (const fs::directory_entry& entry : fs::directory_iterator(dir)) {
+		CHECK(entry.path().filename().string().find("control.enc.") != 0);
+	}
+}
+
+}  // namespace
+
+int main() {
+	dir = MakeTestDir();
+	if (dir.empty()) {
+		return 1;
+	}
+
+	TFLiteModelProtector protector;
+	protector.SetCustomKeyAndIv(kKey, kIv);
+	std::mt19937 rng(49);
+
+	TestSingleFlight(protector, rng);
+	TestJoinGivesUp(protector, rng);
+	TestLoadLockGivesUp(rng);
+	TestDeduplication(protector, rng);
+	TestModelCache(protector, rng);
+	TestNestedTaskGroups();
+	TestOperationControl(protector, rng);
+
+	std::error_code ignored;
+	fs::remove_all(dir, ignored);
+	if (failures != 0) {
+		std::fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+	std::printf("All checks passed\n");
+	return 0;
+}
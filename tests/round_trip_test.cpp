@@ -0,0 +1,246 @@
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "test_support.hpp"
+
+/**
+ * Round-trip and corrupt-input regression tests for the encrypted model and delta formats.
+ *
+ * The plaintext is random bytes rather than a TFLite model: encryption, decryption,
+ * re-encryption and deltas never look inside it.
+ */
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const std::vector<uint8_t> kKey(TFLiteModelProtector::kAesKeyLength, 0x11);
+const std::vector<uint8_t> kIv(TFLiteModelProtector::kAesIvLength, 0x22);
+const std::vector<uint8_t> kNewKey(TFLiteModelProtector::kAesKeyLength, 0x5a);
+const std::vector<uint8_t> kNewIv(TFLiteModelProtector::kAesIvLength, 0xa5);
+
+std::string dir;
+
+std::string Path(const char* name) { return dir + "/" + name; }
+
+// Both formats, with sizes around the block, chunk and I/O step boundaries.
+void TestEncryptDecrypt(TFLiteModelProtector& protector, std::mt19937& rng) {
+	const size_t sizes[] = {0,
+							1,
+							15,
+							16,
+							ModelHeader::kChunkSize - 1,
+							ModelHeader::kChunkSize,
+							ModelHeader::kChunkSize * 3 + 5,
+							TFLiteModelProtector::kIoChunkSize + 17,
+							1000003};
+	for (const bool chunked : {false, true}) {
+		protector.SetChunkedFormat(chunked);
+		for (const size_t size : sizes) {
+			const std::vector<char> data = RandomBytes(rng, size);
+			WriteAll(Path("model.bin"), data);
+			CHECK(protector.EncryptFile(Path("model.bin"), Path("model.enc")));
+			CHECK(Decrypts(protector, Path("model.enc"), data));
+			ModelBuffer buffer;
+			CHECK(protector.DecryptFileToMemory(Path("model.enc"), buffer) &&
+				  buffer.size() == size && std::memcmp(buffer.data(), data.data(), size) == 0);
+			const std::vector<char> encrypted = ReadAll(Path("model.enc"));
+			std::vector<char> from_buffer;
+			CHECK(protector.DecryptBufferToMemory(encrypted.data(), encrypted.size(),
+												  from_buffer) &&
+				  from_buffer == data);
+			CHECK(protector.VerifyEncryptedFile(Path("model.bin"), Path("model.enc")));
+		}
+	}
+	protector.SetChunkedFormat(false);
+}
+
+// ReEncrypt() to a new key and back in place, and ReEncryptFiles() over a batch.
+void TestRekey(TFLiteModelProtector& protector, std::mt19937& rng) {
+	TFLiteModelProtector rekeyed;
+	rekeyed.SetCustomKeyAndIv(kNewKey, kNewIv);
+
+	for (const bool chunked : {false, true}) {
+		protector.SetChunkedFormat(chunked);
+		const std::vector<char> data = RandomBytes(rng, ModelHeader::kChunkSize * 5 + 123);
+		WriteAll(Path("rekey.bin"), data);
+		CHECK(protector.EncryptFile(Path("rekey.bin"), Path("rekey.enc")));
+		const std::vector<char> original = ReadAll(Path("rekey.enc"));
+
+		CHECK(protector.ReEncrypt(Path("rekey.enc"), Path("rekey2.enc"), kNewKey, kNewIv));
+		CHECK(Decrypts(rekeyed, Path("rekey2.enc"), data));
+		CHECK(!Decrypts(protector, Path("rekey2.enc"), data));
+		CHECK_STATUS(kWrongKey);
+
+		// The format is kept, so rotating back in place restores the original bytes.
+		CHECK(rekeyed.ReEncrypt(Path("rekey2.enc"), Path("rekey2.enc"), kKey, kIv));
+		CHECK(ReadAll(Path("rekey2.enc")) == original);
+	}
+	protector.SetChunkedFormat(false);
+
+	std::vector<std::string> files;
+	std::vector<std::vector<char>> contents;
+	for (const char* name : {"batch0.enc", "batch1.enc", "batch2.enc"}) {
+		contents.push_back(RandomBytes(rng, 100000 + files.size()));
+		WriteAll(Path("batch.bin"), contents.back());
+		CHECK(protector.EncryptFile(Path("batch.bin"), Path(name)));
+		files.push_back(Path(name));
+	}
+	CHECK(protector.ReEncryptFiles(files, kNewKey, kNewIv, 2) == 0);
+	for (size_t i = 0; i < files.size(); ++i) {
+		CHECK(Decrypts(rekeyed, files[i], contents[i]));
+	}
+
+	// A missing file fails alone; the rest are still rotated.
+	files.push_back(Path("missing.enc"));
+	CHECK(rekeyed.ReEncryptFiles(files, kKey, kIv) == 1);
+	CHECK(Decrypts(protector, files[0], contents[0]));
+}
+
+// CreateDelta() between two chunked models, then PatchEncryptedFile() and ApplyDelta().
+void TestDiffPatch(TFLiteModelProtector& protector, std::mt19937& rng) {
+	protector.SetChunkedFormat(true);
+	const std::vector<char> old_data = RandomBytes(rng, ModelHeader::kChunkSize * 10 + 777);
+	std::vector<char> new_data = old_data;
+	new_data[ModelHeader::kChunkSize * 3 + 10] ^= 1;
+	new_data[ModelHeader::kChunkSize * 7] ^= 1;
+	new_data.resize(new_data.size() + 100000, 7);
+	WriteAll(Path("old.bin"), old_data);
+	WriteAll(Path("new.bin"), new_data);
+	CHECK(protector.EncryptFile(Path("old.bin"), Path("old.enc")));
+	CHECK(protector.EncryptFile(Path("new.bin"), Path("new.enc")));
+
+	size_t changed = 0;
+	CHECK(TFLiteModelProtector::CreateDelta(Path("old.enc"), Path("new.enc"), Path("up.delta"),
+											&changed));
+	// The two flipped chunks, plus every chunk from the old partial last one on.
+	const size_t new_chunks = (new_data.size() + 16 + ModelHeader::kChunkSize - 1) /
+							  ModelHeader::kChunkSize;
+	CHECK(changed == 2 + (new_chunks - 10));
+	CHECK(TFLiteModelProtector::PatchEncryptedFile(Path("old.enc"), Path("up.delta"),
+												   Path("patched.enc")));
+	CHECK(ReadAll(Path("patched.enc")) == ReadAll(Path("new.enc")));
+
+	DecryptedModel base = protector.LoadDecryptedModel(Path("old.enc"));
+	CHECK(base);
+	DecryptedModel updated = protector.ApplyDelta(base, Path("up.delta"));
+	CHECK(updated && updated.size() == new_data.size() &&
+		  std::memcmp(updated.data(), new_data.data(), new_data.size()) == 0);
+
+	// Shrinking back, and an unchanged model giving an empty delta.
+	CHECK(TFLiteModelProtector::CreateDelta(Path("new.enc"), Path("old.enc"), Path("down.delta")));
+	CHECK(TFLiteModelProtector::PatchEncryptedFile(Path("new.enc"), Path("down.delta"),
+												   Path("patched.enc")));
+	CHECK(ReadAll(Path("patched.enc")) == ReadAll(Path("old.enc")));
+	CHECK(TFLiteModelProtector::CreateDelta(Path("old.enc"), Path("old.enc"), Path("same.delta"),
+											&changed) &&
+		  changed == 0);
+
+	// A delta applies only to the model it was made from.
+	CHECK(!TFLiteModelProtector::PatchEncryptedFile(Path("old.enc"), Path("down.delta"),
+													Path("wrong.enc")));
+	CHECK(!protector.ApplyDelta(base, Path("down.delta")));
+	CHECK_STATUS(kChecksumMismatch);
+
+	// Stream-format models cannot be diffed.
+	protector.SetChunkedFormat(false);
+	CHECK(protector.EncryptFile(Path("old.bin"), Path("stream.enc")));
+	CHECK(!TFLiteModelProtector::CreateDelta(Path("stream.enc"), Path("new.enc"),
+											 Path("stream.delta")));
+	CHECK_STATUS(kBadHeader);
+}
+
+// Damaged files must fail with the right status and never hand back plaintext.
+void TestCorruptInput(TFLiteModelProtector& protector, std::mt19937& rng) {
+	const std::vector<char> data = RandomBytes(rng, ModelHeader::kChunkSize * 4 + 99);
+	WriteAll(Path("good.bin"), data);
+
+	for (const bool chunked : {false, true}) {
+		protector.SetChunkedFormat(chunked);
+		CHECK(protector.EncryptFile(Path("good.bin"), Path("good.enc")));
+		const std::vector<char> good = ReadAll(Path("good.enc"));
+
+		const auto expect_failure = [&](const std::vector<char>& file) {
+			WriteAll(Path("bad.enc"), file);
+			std::vector<char> decrypted;
+			const bool ok = protector.DecryptFileToMemory(Path("bad.enc"), decrypted);
+			CHECK(!ok && decrypted.empty());
+			const ProtectorStatus status = TFLiteModelProtector::LastStatus();
+			decrypted.clear();
+			CHECK(!protector.DecryptBufferToMemory(file.data(), file.size(), decrypted) &&
+				  decrypted.empty() && TFLiteModelProtector::LastStatus() == status);
+			return status;
+		};
+
+		// Plaintext sizes whose CipherSize() would wrap around.
+		for (const uint64_t size : {~0ull, ~0ull - 5, ~0ull - 15}) {
+			ModelHeader header;
+			ModelHeader::Parse(reinterpret_cast<const uint8_t*>(good.data()), good.size(), &header);
+			header.plaintext_size = size;
+			std::vector<char> file = good;
+			header.Serialize(reinterpret_cast<uint8_t*>(file.data()));
+			CHECK(expect_failure(file) == ProtectorStatus::kBadHeader);
+			size_t required = 0;
+			CHECK(!protector.RequiredBufferSize(Path("bad.enc"), &required));
+		}
+
+		std::vector<char> file = good;
+		file[4] = 99;  // version
+		CHECK(expect_failure(file) == ProtectorStatus::kBadHeader);
+
+		file = good;
+		file[5] = 77;  // cipher id
+		CHECK(expect_failure(file) == ProtectorStatus::kBadHeader);
+
+		file.assign(good.begin(), good.end() - 16);
+		CHECK(expect_failure(file) == ProtectorStatus::kTruncated);
+
+		file = good;
+		file.push_back(0);	// not a whole number of blocks
+		CHECK(expect_failure(file) == ProtectorStatus::kTruncated);
+
+		file.assign(good.begin(), good.begin() + ModelHeader::kSize);
+		CHECK(expect_failure(file) == ProtectorStatus::kTruncated);
+
+		file = good;
+		file[ModelHeader::kSize + 100] ^= 1;  // first body block
+		CHECK(expect_failure(file) == ProtectorStatus::kChecksumMismatch);
+
+		TFLiteModelProtector wrong;
+		wrong.SetCustomKeyAndIv(kNewKey, kIv);
+		std::vector<char> decrypted;
+		CHECK(!wrong.DecryptFileToMemory(Path("good.enc"), decrypted) && decrypted.empty());
+		CHECK_STATUS(kWrongKey);
+	}
+	protector.SetChunkedFormat(false);
+}
+
+}  // namespace
+
+int main() {
+	dir = MakeTestDir();
+	if (dir.empty()) {
+		return 1;
+	}
+
+	TFLiteModelProtector protector;
+	protector.SetCustomKeyAndIv(kKey, kIv);
+	std::mt19937 rng(2024);
+
+	TestEncryptDecrypt(protector, rng);
+	TestRekey(protector, rng);
+	TestDiffPatch(protector, rng);
+	TestCorruptInput(protector, rng);
+
+	std::error_code ignored;
+	fs::remove_all(dir, ignored);
+	if (failures != 0) {
+		std::fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+	std::printf("All checks passed\n");
+	return 0;
+}
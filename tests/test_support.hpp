@@ -0,0 +1,62 @@
+#ifndef TFLITE_TEST_SUPPORT_H_
+#define TFLITE_TEST_SUPPORT_H_
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "model_protector.hpp"
+
+// Failed checks are reported and counted instead of aborting; main() turns the count into the
+// exit status.
+inline int failures = 0;
+
+#define CHECK(condition)                                                                       \
+	do {                                                                                       \
+		if (!(condition)) {                                                                    \
+			std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+			++failures;                                                                        \
+		}                                                                                      \
+	} while (0)
+
+#define CHECK_STATUS(expected) \
+	CHECK(TFLiteModelProtector::LastStatus() == ProtectorStatus::expected)
+
+inline std::vector<char> ReadAll(const std::string& path) {
+	std::ifstream in(path, std::ios::binary);
+	return std::vector<char>(std::istreambuf_iterator<char>(in), {});
+}
+
+inline void WriteAll(const std::string& path, const std::vector<char>& data) {
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	out.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+inline std::vector<char> RandomBytes(std::mt19937& rng, size_t size) {
+	std::vector<char> data(size);
+	for (char& c : data) {
+		c = static_cast<char>(rng());
+	}
+	return data;
+}
+
+inline bool Decrypts(TFLiteModelProtector& protector, const std::string& path,
+					 const std::vector<char>& expected) {
+	std::vector<char> decrypted;
+	return protector.DecryptFileToMemory(path, decrypted) && decrypted == expected;
+}
+
+// Creates a scratch directory under /tmp, or returns an empty string.
+inline std::string MakeTestDir() {
+	char dir_template[] = "/tmp/tflite_protector_test.XXXXXX";
+	if (mkdtemp(dir_template) == nullptr) {
+		std::perror("mkdtemp");
+		return std::string();
+	}
+	return dir_template;
+}
+
+#endif	// TFLITE_TEST_SUPPORT_H_